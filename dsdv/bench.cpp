@@ -0,0 +1,243 @@
+#include <getopt.h>
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include "simulator.h"
+#include "topology.h"
+
+static void usage(const char *prog) {
+    std::cout << "usage: " << prog << " [-t type] [-n nodes] [-m dv,ls] [-H none,split,poison] [-r seed] [-l latency] [-p loss_rate]"
+        << " [-j threads] [-z zones [-f]] [-k paths]"
+        << std::endl;
+    exit(0);
+}
+
+// approximate heap footprint of a forwarding table: tree node header, the stored pair,
+// the strings that do not fit in the small string buffer and the alternates
+static size_t tableMemory(const MobileHost &host) {
+    size_t ret = 0;
+    for (const auto &it : host.forwardingTable) {
+        ret += 4 * sizeof(void *) + sizeof(it);
+        if (it.first.capacity() > 15) {
+            ret += it.first.capacity() + 1;
+        }
+        if (it.second.nextHop.capacity() > 15) {
+            ret += it.second.nextHop.capacity() + 1;
+        }
+        ret += it.second.alternates.capacity() * sizeof(PathItem);
+    }
+    return ret;
+}
+
+// compare every converged forwarding table against Dijkstra, return the number of wrong routes:
+// with zones, host routes are shortest inside the zone and a summary is the distance to the closest
+// host of its zone
+static long verify(const Topology &topo, const Simulator &sim, int threads) {
+    std::atomic<long> mismatches(0);
+    std::vector<std::thread> workers;
+    auto zones = topo.zones.empty() ? 0 : (*std::max_element(topo.zones.begin(), topo.zones.end()) + 1);
+    for (auto t = 0; t < threads; ++t) {
+        workers.push_back(std::thread([&, t]() {
+            for (auto i = t; i < static_cast<int>(topo.names.size()); i += threads) {
+                const auto &table = sim.hosts[i]->forwardingTable;
+                auto check = [&](const std::string &destination, double expected) {
+                    auto entry = table.find(destination);
+                    auto metric = (entry == table.end()) ? MAX : std::min<double>(entry->second.metric, MAX);
+                    if (std::fabs(metric - expected) > 1e-6) {
+                        ++mismatches;
+                    }
+                };
+
+                auto dist = topo.shortestPaths(i);
+                if (zones == 0) {
+                    for (size_t j = 0; j < dist.size(); ++j) {
+                        check(topo.names[j], dist[j]);
+                    }
+                    continue;
+                }
+
+                auto local = topo.shortestPaths(i, true);
+                std::vector<double> closest(zones, MAX);
+                for (size_t j = 0; j < dist.size(); ++j) {
+                    if (topo.zones[j] == topo.zones[i]) {
+                        check(topo.names[j], local[j]);
+                    } else {
+                        closest[topo.zones[j]] = std::min(closest[topo.zones[j]], dist[j]);
+                    }
+                }
+                for (auto z = 0; z < zones; ++z) {
+                    if (z != topo.zones[i]) {
+                        check("z" + std::to_string(z) + ".*", closest[z]);
+                    }
+                }
+            }
+        }));
+    }
+    for (auto &it : workers) {
+        it.join();
+    }
+    return mismatches;
+}
+
+// run the hosts of topo, taking down the links of failures at time at, and print one line: convergence,
+// messages and bytes are those of the epochs after the failures if there are any
+static bool simulate(const std::string &label, const Topology &topo, int mode, int horizon, unsigned seed,
+        double latency, double lossRate, int threads, int zones, int paths,
+        const std::vector<std::pair<int, int> > &failures, double &at) {
+    Simulator sim(seed);
+    sim.latency = latency;
+    sim.lossRate = lossRate;
+    sim.quiet = 3 * sim.period;
+    sim.maxTime = 100000;
+    sim.mode = mode;
+    sim.horizon = horizon;
+    sim.zoning = (zones > 0);
+    sim.paths = paths;
+    for (size_t i = 0; i < topo.names.size(); ++i) {
+        sim.addHost(topo.names[i], topo.ports[i], topo.neighbors(i));
+    }
+    // the oracle checks the tables against the topology without the failed links
+    auto after = topo;
+    for (const auto &it : failures) {
+        sim.linkEvents.push_back(LinkEvent(at, topo.names[it.first], topo.names[it.second], -1));
+        after.adjacency[it.first].erase(it.second);
+        after.adjacency[it.second].erase(it.first);
+    }
+    auto converged = sim.run();
+
+    // tables only grow, so their final size is the peak
+    size_t peak = 0;
+    for (const auto &it : sim.hosts) {
+        peak = std::max(peak, tableMemory(*it));
+    }
+    auto mismatches = verify(after, sim, threads);
+
+    // every failure starts an epoch; those taken down at once share their start and the last one sees the rest
+    const auto first = failures.empty() ? 0 : 1;
+    const auto &epoch = failures.empty() ? sim.epochs.front() : sim.epochs.back();
+    long messages = 0, bytes = 0;
+    for (size_t i = first; i < sim.epochs.size(); ++i) {
+        messages += sim.epochs[i].messages;
+        bytes += sim.epochs[i].bytes;
+    }
+    if (failures.empty()) {
+        // the failures of later runs are taken down once this one is converged
+        at = epoch.lastChange + sim.quiet;
+    }
+
+    const char *horizons[] = {"none", "split", "poison"};
+    std::cout << std::left << std::setw(15) << label << std::setw(6) << ((mode == MODE_LS) ? "ls" : "dv")
+        << std::setw(8) << ((mode == MODE_LS) ? "-" : horizons[horizon]) << std::right
+        << std::setw(7) << topo.names.size() << std::setw(7) << topo.edges() << std::setw(7) << zones
+        << setiosflags(std::ios::fixed) << std::setprecision(2)
+        << std::setw(11) << (converged ? (epoch.lastChange - epoch.start) : -1.0)
+        << std::setw(11) << messages << std::setw(13) << bytes
+        << std::setw(11) << sim.cpuTime << std::setw(11) << (sim.cpuTime * 1000 / topo.names.size())
+        << std::setw(11) << (peak / 1024.0) << "  " << (mismatches ? "FAIL " + std::to_string(mismatches) : "ok")
+        << std::endl;
+    return converged;
+}
+
+static void bench(const std::string &type, int n, int mode, int horizon, unsigned seed, double latency,
+        double lossRate, int threads, int zones, int paths, bool failing) {
+    Topology topo;
+    if (!topo.generate(type, n, seed)) {
+        std::cout << "invalid topology " << type << " of " << n << " nodes" << std::endl;
+        exit(0);
+    }
+    if (zones > 0) {
+        topo.partition(zones);
+    }
+
+    double at = 0;
+    if ((!simulate(type, topo, mode, horizon, seed, latency, lossRate, threads, zones, paths, {}, at)) ||
+            (!failing) || (zones == 0)) {
+        return;
+    }
+
+    // the same run again, but once it converged one link out of zone 0 fails, or zone 0 is cut off
+    // from the others: summaries must neither loop nor count to infinity
+    std::vector<std::pair<int, int> > borders;
+    for (size_t i = 0; i < topo.names.size(); ++i) {
+        for (const auto &it : topo.adjacency[i]) {
+            if ((topo.zones[i] == 0) && (topo.zones[it.first] != 0)) {
+                borders.push_back(std::make_pair(static_cast<int>(i), it.first));
+            }
+        }
+    }
+    simulate(type + "+fail", topo, mode, horizon, seed, latency, lossRate, threads, zones, paths,
+        {borders.front()}, at);
+    simulate(type + "+cut", topo, mode, horizon, seed, latency, lossRate, threads, zones, paths, borders, at);
+}
+
+int main(int argc, char *argv[]) {
+    std::vector<std::string> types = {"ring", "grid", "geometric", "scalefree"};
+    std::vector<int> sizes = {16, 64, 256};
+    std::vector<int> modes = {MODE_DV};
+    std::vector<int> horizons = {HORIZON_NONE};
+    unsigned seed = 1;
+    double latency = 0.01, lossRate = 0;
+    int threads = std::max(1u, std::thread::hardware_concurrency());
+    int zones = 0, paths = 1;
+    bool failing = false;
+
+    std::string arg;
+    int opt;
+    while ((opt = getopt(argc, argv, "t:n:m:H:r:l:p:j:z:fk:")) != -1) {
+        switch (opt) {
+        case 't': types = {optarg}; break;
+        case 'n': sizes = {atoi(optarg)}; break;
+        case 'm':
+            modes.clear();
+            for (std::istringstream sin(optarg); std::getline(sin, arg, ','); ) {
+                modes.push_back(parseMode(arg));
+                if (modes.back() < 0) {
+                    usage(argv[0]);
+                }
+            }
+            break;
+        case 'H':
+            horizons.clear();
+            for (std::istringstream sin(optarg); std::getline(sin, arg, ','); ) {
+                horizons.push_back(parseHorizon(arg));
+                if (horizons.back() < 0) {
+                    usage(argv[0]);
+                }
+            }
+            break;
+        case 'r': seed = atoi(optarg); break;
+        case 'l': latency = atof(optarg); break;
+        case 'p': lossRate = atof(optarg); break;
+        case 'j': threads = std::max(1, atoi(optarg)); break;
+        case 'z': zones = atoi(optarg); break;
+        case 'f': failing = true; break;
+        case 'k': paths = std::max(1, std::min(MAX_PATHS, atoi(optarg))); break;
+        default: usage(argv[0]);
+        }
+    }
+    if (optind != argc) {
+        usage(argv[0]);
+    }
+
+    std::cout << std::left << std::setw(15) << "type" << std::setw(6) << "mode" << std::setw(8) << "horizon" << std::right
+        << std::setw(7) << "nodes" << std::setw(7) << "links" << std::setw(7) << "zones"
+        << std::setw(11) << "converge_s" << std::setw(11) << "messages" << std::setw(13) << "bytes"
+        << std::setw(11) << "cpu_ms" << std::setw(11) << "us/node" << std::setw(11) << "table_kb" << "  oracle"
+        << std::endl;
+    for (const auto &type : types) {
+        for (auto n : sizes) {
+            for (auto mode : modes) {
+                // horizons, zones and multipath are distance vector rules, link state runs once without them
+                for (auto horizon : horizons) {
+                    if (mode == MODE_LS) {
+                        bench(type, n, mode, horizon, seed, latency, lossRate, threads, 0, 1, false);
+                        break;
+                    }
+                    bench(type, n, mode, horizon, seed, latency, lossRate, threads, zones, paths, failing);
+                }
+            }
+        }
+    }
+
+    return 0;
+}
@@ -0,0 +1,153 @@
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <algorithm>
+#include "checkpoint.h"
+
+static const char MAGIC[8] = {'D', 'S', 'D', 'V', 'C', 'K', 'P', '1'};
+
+// copy name into a fixed width field, false if it does not fit
+static bool copyName(char *field, const std::string &name) {
+    if (name.size() >= static_cast<size_t>(CHECKPOINT_NAME)) {
+        return false;
+    }
+    memset(field, 0, CHECKPOINT_NAME);
+    memcpy(field, name.data(), name.size());
+    return true;
+}
+
+static std::string readName(const char *field) {
+    return std::string(field, strnlen(field, CHECKPOINT_NAME));
+}
+
+Checkpoint::~Checkpoint() {
+    if (base) {
+        munmap(base, length);
+    }
+    if (fd >= 0) {
+        close(fd);
+    }
+}
+
+bool Checkpoint::open(const std::string &filename) {
+    fd = ::open(filename.c_str(), O_RDWR | O_CREAT | O_CLOEXEC, 0644);
+    if (fd < 0) {
+        std::cerr << "open checkpoint error" << std::endl;
+        return false;
+    }
+
+    struct stat st;
+    if (fstat(fd, &st) < 0) {
+        return false;
+    }
+    return reserve(std::max<size_t>(st.st_size, sizeof(CheckpointHeader)));
+}
+
+bool Checkpoint::restore(MobileHost &host) {
+    auto h = header();
+    if ((memcmp(h->magic, MAGIC, sizeof(MAGIC)) != 0) || (h->generation % 2 != 0) ||
+            (readName(h->name) != host.name) ||
+            (length < sizeof(CheckpointHeader) + (h->routes + h->neighbors) * sizeof(CheckpointRecord))) {
+        return false;
+    }
+
+    // costs of the neighbors when the checkpoint was written
+    std::map<std::string, double> distances;
+    auto r = records();
+    for (uint32_t i = h->routes; i < h->routes + h->neighbors; ++i) {
+        distances[readName(r[i].destination)] = r[i].metric;
+    }
+
+    for (uint32_t i = 0; i < h->routes; ++i) {
+        auto destination = readName(r[i].destination);
+        if (destination == host.name) {
+            host.forwardingTable[destination] = ForwardingTableItem(destination, 0, r[i].seqNum + 2);
+            continue;
+        }
+
+        ForwardingTableItem item(readName(r[i].nextHop), r[i].metric, r[i].seqNum);
+        auto neighbor = host.neighborhood.find(item.nextHop);
+        auto distance = distances.find(item.nextHop);
+        if ((neighbor == host.neighborhood.end()) || (neighbor->second.metric >= MAX)) {
+            item.metric = MAX;
+        } else if ((distance != distances.end()) && (distance->second < MAX) && (item.metric < MAX)) {
+            item.metric += neighbor->second.metric - distance->second;
+        }
+        host.forwardingTable[destination] = item;
+    }
+
+    return true;
+}
+
+void Checkpoint::save(const MobileHost &host) {
+    if ((fd < 0) || (++saves % interval != 0)) {
+        return;
+    }
+
+    auto snapshot = host.snapshot();
+    const auto &table = snapshot->forwardingTable;
+    const auto &neighborhood = snapshot->neighborhood;
+    if (!reserve(sizeof(CheckpointHeader) + (table.size() + neighborhood.size()) * sizeof(CheckpointRecord))) {
+        return;
+    }
+
+    auto h = header();
+    // odd while writing, whatever a save torn by a crash left behind
+    h->generation |= 1;
+    __sync_synchronize();
+    memcpy(h->magic, MAGIC, sizeof(MAGIC));
+    copyName(h->name, host.name);
+
+    uint32_t count = 0;
+    auto r = records();
+    for (const auto &it : table) {
+        if (copyName(r[count].destination, it.first) && copyName(r[count].nextHop, it.second.nextHop)) {
+            r[count].metric = it.second.metric;
+            r[count].seqNum = it.second.seqNum;
+            r[count].port = 0;
+            ++count;
+        }
+    }
+    h->routes = count;
+    for (const auto &it : neighborhood) {
+        if (copyName(r[count].destination, it.first)) {
+            memset(r[count].nextHop, 0, CHECKPOINT_NAME);
+            r[count].metric = it.second.metric;
+            r[count].seqNum = 0;
+            r[count].port = it.second.port;
+            ++count;
+        }
+    }
+    h->neighbors = count - h->routes;
+
+    // the records are complete before the generation becomes even again
+    __sync_synchronize();
+    h->generation += 1;
+}
+
+// grow the file and the mapping to at least size bytes
+bool Checkpoint::reserve(size_t size) {
+    if (size <= length) {
+        return true;
+    }
+
+    auto next = std::max(size, 2 * length);
+    if (ftruncate(fd, next) < 0) {
+        std::cerr << "resize checkpoint error" << std::endl;
+        return false;
+    }
+    if (base) {
+        munmap(base, length);
+    }
+    auto p = mmap(nullptr, next, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    if (p == MAP_FAILED) {
+        std::cerr << "map checkpoint error" << std::endl;
+        base = nullptr;
+        length = 0;
+        return false;
+    }
+
+    base = static_cast<char *>(p);
+    length = next;
+    return true;
+}
@@ -0,0 +1,62 @@
+#ifndef CHECKPOINT_H_
+#define CHECKPOINT_H_
+
+#include <cstdint>
+#include "dsdv.h"
+
+// host names are stored in fixed width fields, routes to longer names are not checkpointed
+const int CHECKPOINT_NAME = 32;
+
+// a route (destination, nextHop, metric, seqNum) or a neighbor (destination, metric, port)
+class CheckpointRecord {
+public:
+    char destination[CHECKPOINT_NAME];
+    char nextHop[CHECKPOINT_NAME];
+    double metric;
+    int32_t seqNum;
+    int32_t port;
+};
+
+class CheckpointHeader {
+public:
+    char magic[8];
+    // odd while a checkpoint is being written, so a torn one is never restored
+    uint64_t generation;
+    char name[CHECKPOINT_NAME];
+    uint32_t routes;
+    uint32_t neighbors;
+};
+
+// routing state of a host kept in a memory-mapped file, so that a restarted host
+// starts with its last forwarding table instead of only its neighbors
+class Checkpoint {
+public:
+    // write a checkpoint on every interval-th save() call
+    int interval;
+
+    Checkpoint() : interval(1), fd(-1), base(nullptr), length(0), saves(0) {}
+    ~Checkpoint();
+
+    // map filename, creating it if needed
+    bool open(const std::string &filename);
+
+    // load the last checkpoint of the same host into its forwarding table: routes through neighbors
+    // that are down now get metric MAX, routes through neighbors whose cost changed are adjusted,
+    // and our own sequence number is advanced past the saved one so that our routes win again
+    bool restore(MobileHost &host);
+
+    // checkpoint the current snapshot of host
+    void save(const MobileHost &host);
+
+private:
+    int fd;
+    char *base;
+    size_t length;
+    long saves;
+
+    bool reserve(size_t size);
+    CheckpointHeader *header() { return reinterpret_cast<CheckpointHeader *>(base); }
+    CheckpointRecord *records() { return reinterpret_cast<CheckpointRecord *>(base + sizeof(CheckpointHeader)); }
+};
+
+#endif
@@ -1,11 +1,47 @@
+#include <algorithm>
 #include "dsdv.h"
-    
+
+bool MobileHost::publish() {
+    if (!dirty) {
+        return false;
+    }
+
+    auto next = new TableSnapshot;
+    next->version = ++version;
+    next->forwardingTable = forwardingTable;
+    next->neighborhood = neighborhood;
+    next->zoneSeqNum = zoneSeqNum;
+    for (const auto &it : neighborhood) {
+        if (it.second.metric < MAX) {
+            next->neighbors.push_back(it.second.addr);
+        }
+    }
+    current.publish(next);
+    dirty = false;
+    return true;
+}
+
+RcuPointer<class TableSnapshot>::ReadGuard MobileHost::snapshot() const {
+    return current.read();
+}
+
+bool MobileHost::lookup(const std::string &destination, class ForwardingTableItem &item) const {
+    auto snapshot = current.read();
+    auto it = snapshot->forwardingTable.find(destination);
+    if (it == snapshot->forwardingTable.end()) {
+        return false;
+    }
+    item = it->second;
+    return true;
+}
+
 std::string MobileHost::serialize() {
     std::ostringstream sout;
+    auto snapshot = current.read();
 
     // nextHop -- lines
-    sout << name << ' ' << forwardingTable.size() << ' ';
-    for (const auto &it : forwardingTable) {
+    sout << name << ' ' << snapshot->forwardingTable.size() << ' ';
+    for (const auto &it : snapshot->forwardingTable) {
         // destination -- metric -- seqNum
         sout << it.first << ' ' << it.second.metric << ' ' << it.second.seqNum << ' ';
     }
@@ -13,6 +49,118 @@ std::string MobileHost::serialize() {
     return sout.str();
 }
 
+// append routes "destination metric seqNum ..." to packet as segments of exactly segmentSize bytes but
+// the last, each with its own "name count" header and padded with spaces, so that every segment can be
+// merged on its own and a lost one only costs its routes
+static void appendSegments(std::string &packet, const std::string &name, const char *routes, size_t len,
+        size_t segmentSize) {
+    // the count is padded to a fixed width, so it can be filled in once the segment is full
+    const size_t header = name.size() + 8;
+    size_t p = 0;
+    do {
+        auto begin = packet.size();
+        packet.append(name).append(header - name.size(), ' ');
+        int count = 0;
+        while (p < len) {
+            // a route is three tokens, each followed by a space
+            auto q = p;
+            for (auto i = 0; (i < 3) && (q < len); ++i) {
+                auto space = static_cast<const char *>(memchr(routes + q, ' ', len - q));
+                q = (space == NULL) ? len : (space - routes + 1);
+            }
+            if (packet.size() - begin + (q - p) > segmentSize) {
+                if (count > 0) {
+                    break;
+                }
+                // a route that does not even fit an empty segment cannot be sent
+                p = q;
+                continue;
+            }
+            packet.append(routes + p, q - p);
+            p = q;
+            ++count;
+        }
+        auto digits = std::to_string(count);
+        packet.replace(begin + name.size() + 1, digits.size(), digits);
+        if (p < len) {
+            packet.append(begin + segmentSize - packet.size(), ' ');
+        }
+    } while (p < len);
+}
+
+void MobileHost::advertise(class Advertisements &ads, size_t segmentSize) {
+    ads.clear();
+    // without horizon rules and zones every neighbor gets the same packet
+    auto shared = (horizon == HORIZON_NONE) && (!zoning);
+
+    auto snapshot = current.read();
+    const auto &table = snapshot->forwardingTable;
+    // every route is encoded once, the per-neighbor packets are cut from body,
+    // starts[i] is where the i-th route begins in it
+    std::vector<size_t> starts;
+    std::ostringstream sout;
+    for (const auto &it : table) {
+        starts.push_back(sout.tellp());
+        sout << it.first << ' ' << it.second.metric << ' ' << it.second.seqNum << ' ';
+    }
+    auto body = sout.str();
+    starts.push_back(body.size());
+    if (shared) {
+        ads.packets.push_back(std::string());
+        appendSegments(ads.packets.back(), name, body.data(), body.size(), segmentSize);
+    }
+
+    std::string routes;
+    for (const auto &neighbor : snapshot->neighborhood) {
+        if (neighbor.second.metric >= MAX) {
+            continue;
+        }
+        ads.addrs.push_back(neighbor.second.addr);
+        ads.neighbors.push_back(std::make_pair(neighbor.first, static_cast<int>(ads.packets.size())));
+        if (shared) {
+            ads.neighbors.back().second = 0;
+            continue;
+        }
+
+        // a neighbor in another zone only gets summaries, and ours
+        auto foreign = zoning && (!sameZone(neighbor.first));
+        routes.clear();
+        // copy runs of routes that are advertised as they are in one go
+        size_t run = 0, i = 0;
+        for (auto it = table.begin(); it != table.end(); ++it, ++i) {
+            bool omit = false, poison = false;
+            if (zoning) {
+                auto local = sameZone(it->first);
+                auto summary = isSummary(it->first);
+                // hosts of other zones are never advertised and hosts of ours only inside it; a zone's
+                // own summary still goes to its members, which only take its sequence number
+                omit = (!local && !summary) || (foreign && local);
+            }
+            if ((!omit) && (it->second.nextHop == neighbor.first) && (horizon != HORIZON_NONE)) {
+                omit = (horizon == HORIZON_SPLIT);
+                poison = (horizon == HORIZON_POISON);
+            }
+            if ((!omit) && (!poison)) {
+                continue;
+            }
+
+            routes.append(&body[starts[run]], starts[i] - starts[run]);
+            run = i + 1;
+            if (poison) {
+                routes.append(it->first).append(" ").append(std::to_string(MAX)).append(" ")
+                    .append(std::to_string(it->second.seqNum)).append(" ");
+            }
+        }
+        routes.append(&body[starts[run]], starts[i] - starts[run]);
+        // border hosts originate the summary of their zone, and tell the other hosts of the zone its
+        // sequence number
+        routes.append(zone).append(".* ").append(std::to_string(foreign ? 0 : MAX)).append(" ")
+            .append(std::to_string(snapshot->zoneSeqNum)).append(" ");
+        ads.packets.push_back(std::string());
+        appendSegments(ads.packets.back(), name, routes.data(), routes.size(), segmentSize);
+    }
+}
+
 std::map<std::string, class RouteTableItem> MobileHost::deserialize(const std::string &str, std::string &nextHop) {
     std::map<std::string, class RouteTableItem> ret;
     std::string destination;
@@ -29,89 +177,562 @@ std::map<std::string, class RouteTableItem> MobileHost::deserialize(const std::s
     return ret;
 }
 
-void MobileHost::updateForwardingTable(const std::string &nextHop, const std::map<std::string, 
+bool MobileHost::updateForwardingTable(const std::string &nextHop, const std::map<std::string, 
         class RouteTableItem> &routeTable) {
     auto distance = neighborhood[nextHop].metric;
+    bool changed = false;
     //std::cout << "========= Receive from " << nextHop << " distance is " << distance << std::endl;
     for (const auto &it : routeTable) {
-        if (it.first == name) {
+        if (mergeRoute(it.first, nextHop, distance, it.second.metric, it.second.seqNum)) {
+            changed = true;
+        }
+    }
+
+    return changed;
+}
+
+// split the next space separated token off [p, end)
+static bool nextToken(const char *&p, const char *end, const char *&token, size_t &size) {
+    while ((p < end) && ((*p == ' ') || (*p == '\0'))) {
+        ++p;
+    }
+    token = p;
+    while ((p < end) && (*p != ' ') && (*p != '\0')) {
+        ++p;
+    }
+    size = p - token;
+    return size > 0;
+}
+
+// the token is not NUL-terminated, so it is copied to the stack for strtod
+static bool parseNumber(const char *token, size_t size, double &value) {
+    char buf[32];
+    if (size >= sizeof(buf)) {
+        return false;
+    }
+    memcpy(buf, token, size);
+    buf[size] = '\0';
+
+    char *end;
+    value = strtod(buf, &end);
+    return end == buf + size;
+}
+
+bool MobileHost::mergeAdvertisement(const char *buf, size_t len) {
+    const char *p = buf, *end = buf + len, *token;
+    size_t size;
+    double lines, metric, sequence;
+
+    // nextHop -- lines
+    if (!nextToken(p, end, token, size)) {
+        return false;
+    }
+    mergeNextHop.assign(token, size);
+    auto neighbor = neighborhood.find(mergeNextHop);
+    if ((neighbor == neighborhood.end()) || (!nextToken(p, end, token, size)) || (!parseNumber(token, size, lines))) {
+        // advertisements from hosts that are not our neighbors are ignored
+        return false;
+    }
+
+    bool changed = false;
+    for (auto i = 0; i < lines; ++i) {
+        // destination -- metric -- seqNum
+        if (!nextToken(p, end, token, size)) {
+            break;
+        }
+        mergeDestination.assign(token, size);
+        if ((!nextToken(p, end, token, size)) || (!parseNumber(token, size, metric)) ||
+                (!nextToken(p, end, token, size)) || (!parseNumber(token, size, sequence))) {
+            break;
+        }
+        if (mergeRoute(mergeDestination, mergeNextHop, neighbor->second.metric, metric, sequence)) {
+            changed = true;
+        }
+    }
+
+    return changed;
+}
+
+void MergeBatch::clear() {
+    keys.clear();
+    senders.clear();
+    routes.clear();
+}
+
+uint32_t MergeBatch::append(const char *str, size_t len) {
+    uint32_t offset = keys.size();
+    keys.insert(keys.end(), str, str + len);
+    return offset;
+}
+
+bool MergeBatch::parse(const char *buf, size_t len) {
+    const char *p = buf, *end = buf + len, *token;
+    size_t size;
+    double lines, metric, sequence;
+
+    // nextHop -- lines
+    if (!nextToken(p, end, token, size)) {
+        return false;
+    }
+    std::pair<uint32_t, uint32_t> sender(append(token, size), size);
+    if ((!nextToken(p, end, token, size)) || (!parseNumber(token, size, lines))) {
+        keys.resize(sender.first);
+        return false;
+    }
+    senders.push_back(sender);
+
+    for (auto i = 0; i < lines; ++i) {
+        // destination -- metric -- seqNum
+        if (!nextToken(p, end, token, size)) {
+            break;
+        }
+        Route route;
+        route.offset = keys.size();
+        route.length = size;
+        route.sender = senders.size() - 1;
+        auto destination = token;
+        if ((!nextToken(p, end, token, size)) || (!parseNumber(token, size, metric)) ||
+                (!nextToken(p, end, token, size)) || (!parseNumber(token, size, sequence))) {
+            break;
+        }
+        append(destination, route.length);
+        route.metric = metric;
+        route.seqNum = sequence;
+        routes.push_back(route);
+    }
+
+    return true;
+}
+
+void MergeBatch::sort() {
+    const char *base = keys.data();
+    std::stable_sort(routes.begin(), routes.end(), [base](const Route &a, const Route &b) {
+        auto ret = memcmp(base + a.offset, base + b.offset, std::min(a.length, b.length));
+        return (ret < 0) || ((ret == 0) && (a.length < b.length));
+    });
+}
+
+bool MobileHost::mergeAdvertisements(const class MergeBatch &batch) {
+    // one neighborhood lookup per advertisement instead of per route
+    mergeDistances.clear();
+    for (const auto &it : batch.senders) {
+        mergeNextHop.assign(&batch.keys[it.first], it.second);
+        auto neighbor = neighborhood.find(mergeNextHop);
+        // advertisements from hosts that are not our neighbors are ignored
+        mergeDistances.push_back((neighbor == neighborhood.end()) ? -1 : neighbor->second.metric);
+    }
+
+    bool changed = false;
+    const auto &routes = batch.routes;
+    for (size_t i = 0, j; i < routes.size(); i = j) {
+        // routes to one destination are adjacent, the first newest and shortest one wins as if merged one by one
+        const MergeBatch::Route *best = nullptr;
+        double bestMetric = 0;
+        for (j = i; (j < routes.size()) && (routes[j].length == routes[i].length) &&
+                (memcmp(&batch.keys[routes[j].offset], &batch.keys[routes[i].offset], routes[i].length) == 0); ++j) {
+            auto distance = mergeDistances[routes[j].sender];
+            if (distance < 0) {
+                continue;
+            }
+            auto metric = routes[j].metric + distance;
+            if ((!best) || (best->seqNum < routes[j].seqNum) || ((best->seqNum == routes[j].seqNum) && (bestMetric > metric))) {
+                best = &routes[j];
+                bestMetric = metric;
+            }
+        }
+        if (!best) {
             continue;
         }
-        if (forwardingTable.find(it.first) == forwardingTable.end()) {
-            //std::cout << "Add " << it.first << " with " << (it.second.metric + distance) << std::endl;
-            forwardingTable[it.first] = ForwardingTableItem(nextHop, it.second.metric + distance, it.second.seqNum);
-        } else {
-            if (forwardingTable[it.first].seqNum < it.second.seqNum) {
-                //std::cout << "SeqNum " << forwardingTable[it.first].seqNum << " < " << it.second.seqNum;
-                //std::cout << " Update " << it.first << " from " << forwardingTable[it.first].metric << " to " << (it.second.metric + distance) << std::endl;
-                forwardingTable[it.first] = ForwardingTableItem(nextHop, it.second.metric + distance, it.second.seqNum);
-            } else if ((forwardingTable[it.first].seqNum == it.second.seqNum) &&
-                    (forwardingTable[it.first].metric > (it.second.metric + distance))) {
-                //std::cout << "Change " << it.first << " from " << forwardingTable[it.first].metric << " to " << (it.second.metric + distance) << std::endl;
-                forwardingTable[it.first] = ForwardingTableItem(nextHop, it.second.metric + distance, it.second.seqNum);
+
+        const auto &sender = batch.senders[best->sender];
+        mergeDestination.assign(&batch.keys[best->offset], best->length);
+        mergeNextHop.assign(&batch.keys[sender.first], sender.second);
+        if (mergeRoute(mergeDestination, mergeNextHop, mergeDistances[best->sender], best->metric, best->seqNum)) {
+            changed = true;
+        }
+        if (paths == 1) {
+            continue;
+        }
+        // the others can still become alternates of the best one
+        for (auto k = i; k < j; ++k) {
+            if ((&routes[k] == best) || (mergeDistances[routes[k].sender] < 0)) {
+                continue;
             }
+            const auto &other = batch.senders[routes[k].sender];
+            mergeNextHop.assign(&batch.keys[other.first], other.second);
+            mergeRoute(mergeDestination, mergeNextHop, mergeDistances[routes[k].sender], routes[k].metric, routes[k].seqNum);
         }
     }
+
+    return changed;
 }
 
-bool MobileHost::refreshNeighborInfo(const std::string &filename) {
-    std::ifstream fin(filename.c_str(), std::ifstream::in);
-    if (!fin.good()) {
-        fin.close();
-        exit(0);
+bool MobileHost::mergeRoute(const std::string &destination, const std::string &nextHop, double distance,
+        double metric, int sequence) {
+    if (destination == name) {
+        return false;
+    }
+    if (zoning) {
+        // hosts of other zones are only reached through their summaries, which are merged like host
+        // routes: a summary broken with an odd sequence number stays broken until a border host of its
+        // zone originates a newer one, so summaries cannot count to infinity
+        if ((!sameZone(destination)) && (!isSummary(destination))) {
+            return false;
+        }
+        // our own zone's summary is useless to us but for its sequence number, which moves past the
+        // one it was broken with
+        if (isSummary(destination) && sameZone(destination)) {
+            auto next = sequence + (sequence & 1);
+            if (next > zoneSeqNum) {
+                zoneSeqNum = next;
+                dirty = true;
+            }
+            return false;
+        }
     }
 
-    bool flag = false;
-    int lines;
-    std::string name;
-    fin >> lines >> name;
+    auto reported = metric;
+    metric += distance;
+    if (isSummary(destination)) {
+        metric = std::min<double>(metric, MAX);
+    }
+    auto entry = forwardingTable.find(destination);
+    if (entry == forwardingTable.end()) {
+        //std::cout << "Add " << destination << " with " << metric << std::endl;
+        forwardingTable[destination] = ForwardingTableItem(nextHop, metric, sequence);
+        dirty = true;
+        ++changes;
+        return true;
+    }
 
-    for (auto i = 0; i < lines; ++i) {
-        std::string neighborName;
-        double neighborMetric;
-        int neighborPort;
-        fin >> neighborName >> neighborMetric >> neighborPort;
-        if (neighborhood[neighborName].metric < MAX) {
-            if (neighborMetric < 0) {
+    auto &item = entry->second;
+    if ((item.seqNum < sequence) || ((item.seqNum == sequence) && (item.metric > metric))) {
+        //std::cout << "Update " << destination << " from " << item.metric << " to " << metric << std::endl;
+        bool changed = (item.nextHop != nextHop) || (item.metric != metric);
+        if ((paths > 1) && (item.seqNum < sequence)) {
+            // alternates of an older sequence number may lead back to us
+            item.alternates.clear();
+        } else if ((paths > 1) && (item.nextHop != nextHop) && (item.metric < MAX)) {
+            // a shorter path at the same sequence number, the old primary may stay as an alternate
+            auto neighbor = neighborhood.find(item.nextHop);
+            if (neighbor != neighborhood.end()) {
+                mergeAlternate(item, item.nextHop, item.metric - neighbor->second.metric, item.metric);
+            }
+        }
+        // assigned field by field, so that nextHop reuses its storage
+        item.nextHop.assign(nextHop);
+        item.metric = metric;
+        item.seqNum = sequence;
+        dirty = true;
+        changes += changed;
+        if (paths > 1) {
+            // the new primary is no alternate, and the others must still be feasible for the shorter metric
+            for (auto it = item.alternates.begin(); it != item.alternates.end(); ) {
+                if ((it->nextHop == nextHop) || (it->reported >= metric)) {
+                    it = item.alternates.erase(it);
+                } else {
+                    ++it;
+                }
+            }
+        }
+        return changed;
+    }
+
+    if ((paths > 1) && (item.seqNum == sequence) && (item.nextHop != nextHop)) {
+        mergeAlternate(item, nextHop, reported, metric);
+    }
+    return false;
+}
+
+// alternates do not change what we advertise, so they only mark the table dirty
+void MobileHost::mergeAlternate(class ForwardingTableItem &item, const std::string &nextHop, double reported,
+        double metric) {
+    auto &alternates = item.alternates;
+    auto it = alternates.begin();
+    while ((it != alternates.end()) && (it->nextHop != nextHop)) {
+        ++it;
+    }
+
+    // feasibility condition: the alternate must be closer to the destination than we are
+    if ((reported >= item.metric) || (metric >= MAX)) {
+        if (it != alternates.end()) {
+            alternates.erase(it);
+            dirty = true;
+        }
+        return;
+    }
+
+    if (it != alternates.end()) {
+        if ((it->reported == reported) && (it->metric == metric)) {
+            return;
+        }
+        alternates.erase(it);
+    } else if ((static_cast<int>(alternates.size()) >= paths - 1) && (alternates.back().metric <= metric)) {
+        return;
+    } else if (static_cast<int>(alternates.size()) >= paths - 1) {
+        alternates.pop_back();
+    }
+
+    it = alternates.begin();
+    while ((it != alternates.end()) && (it->metric <= metric)) {
+        ++it;
+    }
+    alternates.insert(it, PathItem(nextHop, reported, metric));
+    dirty = true;
+}
+
+// replace a primary next hop that just failed by the best alternate, false if there is none
+bool MobileHost::failover(class ForwardingTableItem &item) {
+    if (item.alternates.empty()) {
+        return false;
+    }
+
+    auto &best = item.alternates.front();
+    item.nextHop.swap(best.nextHop);
+    item.metric = best.metric;
+    item.alternates.erase(item.alternates.begin());
+    ++changes;
+    return true;
+}
+
+// a summary has an origin in every border host of its zone, none of which hears that it broke, so the
+// break is told with an odd sequence number that only a newer summary from the zone supersedes
+void MobileHost::breakRoute(const std::string &destination, class ForwardingTableItem &item) {
+    item.metric = MAX;
+    if (zoning && isSummary(destination) && (item.seqNum % 2 == 0)) {
+        ++item.seqNum;
+    }
+}
+
+bool MobileHost::sameZone(const std::string &destination) const {
+    return (zoneLength(destination) == zone.size()) && (destination.compare(0, zone.size(), zone) == 0);
+}
+
+bool MobileHost::updateNeighbor(const std::string &neighborName, double neighborMetric, int neighborPort) {
+    bool flag = false;
+    auto known = neighborhood.find(neighborName);
+    auto down = (known == neighborhood.end()) || (known->second.metric >= MAX);
+    if (neighborhood[neighborName].metric < MAX) {
+        if (neighborMetric < 0) {
+            if (mode == MODE_DV) {
                 ++forwardingTable[neighborName].seqNum;
-                neighborMetric = MAX;
-            }
-            if (neighborhood[neighborName].metric != neighborMetric) {
-                flag = true;
-                neighborhood[neighborName] = NeighborInfo(neighborMetric, neighborPort);
-                if (forwardingTable.find(neighborName) != forwardingTable.end()) {
-                    forwardingTable[neighborName].metric = neighborMetric;
-                    for (auto &it : forwardingTable) {
-                        if (it.second.nextHop == neighborName) {
-                            it.second.metric = MAX;   
-                        }
+            }
+            neighborMetric = MAX;
+        }
+        if (neighborhood[neighborName].metric != neighborMetric) {
+            flag = true;
+            neighborhood[neighborName] = NeighborInfo(neighborMetric, neighborPort);
+            // in link-state mode the routes follow from the next LSA we originate
+            if ((mode == MODE_DV) && (forwardingTable.find(neighborName) != forwardingTable.end())) {
+                forwardingTable[neighborName].metric = neighborMetric;
+                for (auto &it : forwardingTable) {
+                    if (paths > 1) {
+                        updateAlternates(it.second, neighborName, neighborMetric);
+                    }
+                    // with multipath the best alternate takes over at once
+                    if ((it.second.nextHop == neighborName) && ((paths == 1) || (!failover(it.second)))) {
+                        breakRoute(it.first, it.second);
                     }
                 }
             }
+        }
+    } else {
+        if (neighborMetric >= 0) {
+            flag = true;
+            //++forwardingTable[neighborName].seqNum;
+            neighborhood[neighborName] = NeighborInfo(neighborMetric, neighborPort);
+            // the link itself is a route, and a restarted neighbor may advertise sequence numbers
+            // below the one we broke it with for a long time
+            auto direct = forwardingTable.find(neighborName);
+            if ((mode == MODE_DV) && (direct != forwardingTable.end()) && (direct->second.metric > neighborMetric)) {
+                direct->second.nextHop = neighborName;
+                direct->second.metric = neighborMetric;
+                direct->second.alternates.clear();
+            }
+        }
+    }
+
+    if (flag) {
+        dirty = true;
+        // a neighbor that just came up has the rest of the network to tell us about
+        if ((down) && (neighborhood[neighborName].metric < MAX)) {
+            request(neighborName);
+        }
+    }
+    return flag;
+}
+
+// alternates through a neighbor whose cost changed follow it, those through a dead one are dropped
+void MobileHost::updateAlternates(class ForwardingTableItem &item, const std::string &neighborName, double neighborMetric) {
+    for (auto it = item.alternates.begin(); it != item.alternates.end(); ) {
+        if (it->nextHop != neighborName) {
+            ++it;
+        } else if (neighborMetric >= MAX) {
+            it = item.alternates.erase(it);
         } else {
-            if (neighborMetric >= 0) {
-                flag = true;
-                //++forwardingTable[neighborName].seqNum;
-                neighborhood[neighborName] = NeighborInfo(neighborMetric, neighborPort);
+            it->metric = it->reported + neighborMetric;
+            ++it;
+        }
+    }
+    std::stable_sort(item.alternates.begin(), item.alternates.end(), [](const PathItem &a, const PathItem &b) {
+        return a.metric < b.metric;
+    });
+}
+
+bool MobileHost::applyNeighborInfo(const std::map<std::string, class NeighborInfo> &neighbors) {
+    bool flag = false;
+    for (const auto &it : neighbors) {
+        // skip the links that are the same as what we already have
+        auto current = neighborhood.find(it.first);
+        if (current != neighborhood.end()) {
+            auto metric = (it.second.metric < 0) ? MAX : it.second.metric;
+            if (current->second.metric == metric) {
+                continue;
             }
         }
+        if (updateNeighbor(it.first, it.second.metric, it.second.port)) {
+            flag = true;
+        }
     }
 
     if (flag) {
         forwardingTable[name].seqNum += 2;
+        if (mode == MODE_LS) {
+            originate();
+        }
     }
 
-    fin.close();
     return flag;
 }
 
-void MobileHost::printOut() {
-    std::cout << "## print-out number " << (seqNum / 2) << std::endl;
-    for (const auto &it : forwardingTable) {
+int MobileHost::ageRoutes(const std::string &neighborName) {
+    int aged = 0;
+    for (auto &it : forwardingTable) {
+        if (paths > 1) {
+            updateAlternates(it.second, neighborName, MAX);
+        }
+        // the link itself is still confirmed by hellos
+        if ((it.first != neighborName) && (it.second.nextHop == neighborName) && (it.second.metric < MAX)) {
+            if ((paths == 1) || (!failover(it.second))) {
+                breakRoute(it.first, it.second);
+            }
+            ++aged;
+            ++changes;
+        }
+    }
+
+    if (aged > 0) {
+        dirty = true;
+    }
+    return aged;
+}
+
+void MobileHost::request(const std::string &neighborName) {
+    auto neighbor = neighborhood.find(neighborName);
+    if (neighbor == neighborhood.end()) {
+        return;
+    }
+    outbox.packets.push_back(std::string(1, PKT_REQUEST).append(" ").append(name));
+    outbox.neighbors.push_back(std::make_pair(neighborName, static_cast<int>(outbox.packets.size() - 1)));
+    outbox.addrs.push_back(neighbor->second.addr);
+}
+
+void MobileHost::answer(const std::string &neighborName, class Advertisements &ads, size_t segmentSize) {
+    auto neighbor = neighborhood.find(neighborName);
+    if ((neighbor == neighborhood.end()) || (neighbor->second.metric >= MAX)) {
+        return;
+    }
+    if (mode == MODE_LS) {
+        // every LSA we have, the requester installs those that are newer than its own
+        for (size_t i = 0; i < linkState.names.size(); ++i) {
+            if (linkState.seqNums[i] >= 0) {
+                auto first = ads.packets.size();
+                lsa(i, segmentSize, ads.packets);
+                for (auto packet = first; packet < ads.packets.size(); ++packet) {
+                    ads.neighbors.push_back(std::make_pair(neighborName, static_cast<int>(packet)));
+                    ads.addrs.push_back(neighbor->second.addr);
+                }
+            }
+        }
+        return;
+    }
+
+    // the same packet the requester gets every period, horizon rules and zones included
+    Advertisements all;
+    advertise(all, segmentSize);
+    for (size_t i = 0; i < all.neighbors.size(); ++i) {
+        if (all.neighbors[i].first == neighborName) {
+            ads.packets.push_back(std::move(all.packets[all.neighbors[i].second]));
+            ads.neighbors.push_back(std::make_pair(neighborName, static_cast<int>(ads.packets.size() - 1)));
+            ads.addrs.push_back(all.addrs[i]);
+            break;
+        }
+    }
+}
+
+bool MobileHost::refreshNeighborInfo(const std::string &filename) {
+    std::string hostName;
+    std::map<std::string, class NeighborInfo> neighbors;
+    if (!loadNeighborFile(filename, hostName, neighbors)) {
+        exit(0);
+    }
+
+    return applyNeighborInfo(neighbors);
+}
+
+void MobileHost::printOut(std::ostream &out) {
+    auto snapshot = current.read();
+    out << "## print-out number " << (seqNum / 2) << std::endl;
+    for (const auto &it : snapshot->forwardingTable) {
         if (it.second.metric < MAX) {
-            std::cout << "shortest path to node " << it.first << " (seq# " << it.second.seqNum << "): the next hop is "
+            out << "shortest path to node " << it.first << " (seq# " << it.second.seqNum << "): the next hop is "
                 << it.second.nextHop << " and the cost is " << setiosflags(std::ios::fixed) << std::setprecision(2) 
                 << it.second.metric << ", " << name << " -> " << it.first << " : " << it.second.metric << std::endl;
+            for (const auto &alternate : it.second.alternates) {
+                out << "    alternate next hop " << alternate.nextHop << " with cost " << alternate.metric << std::endl;
+            }
         }
     }
 }
+
+int parseMode(const std::string &str) {
+    if (str == "dv") {
+        return MODE_DV;
+    } else if (str == "ls") {
+        return MODE_LS;
+    }
+    return -1;
+}
+
+int parseHorizon(const std::string &str) {
+    if (str == "none") {
+        return HORIZON_NONE;
+    } else if (str == "split") {
+        return HORIZON_SPLIT;
+    } else if (str == "poison") {
+        return HORIZON_POISON;
+    }
+    return -1;
+}
+
+bool loadNeighborFile(const std::string &filename, std::string &name, std::map<std::string, class NeighborInfo> &neighbors) {
+    std::ifstream fin(filename.c_str(), std::ifstream::in);
+    if (!fin.good()) {
+        fin.close();
+        return false;
+    }
+
+    int lines;
+    fin >> lines >> name;
+    for (auto i = 0; i < lines; ++i) {
+        std::string neighborName;
+        double neighborMetric;
+        int neighborPort;
+        fin >> neighborName >> neighborMetric >> neighborPort;
+        // negative metric means the link is down, left for the caller to interpret
+        neighbors[neighborName] = NeighborInfo(neighborMetric, neighborPort);
+    }
+
+    fin.close();
+    return true;
+}
@@ -10,16 +10,46 @@
 #include <sstream>
 #include <thread>
 #include <mutex>
+#include <condition_variable>
 #include "util.h"
+#include "rcu.h"
+#include "linkstate.h"
 
 const int MAX = 10000;
 
+// how routes learned from a neighbor are advertised back to it
+enum { HORIZON_NONE = 0, HORIZON_SPLIT, HORIZON_POISON };
+
+// distance vector (DSDV) or link-state routing
+enum { MODE_DV = 0, MODE_LS };
+
+// first byte of a table request, followed by a space and the name of its sender
+const char PKT_REQUEST = 0x04;
+
+// most next hops kept per destination, the primary one included
+const int MAX_PATHS = 4;
+
+// another next hop to a destination
+class PathItem {
+public:
+    std::string nextHop;
+    // metric advertised by nextHop, without the distance to it
+    double reported;
+    double metric;
+
+    PathItem() = default;
+    PathItem(std::string n, double r, double m) : nextHop(n), reported(r), metric(m) {}
+};
+
 class ForwardingTableItem {
 public:
     //std::string destination;
     std::string nextHop;
     double metric;
     int seqNum;
+    // feasible alternates learned at seqNum, best first and at most MAX_PATHS - 1: each of them
+    // reported a metric below ours, so switching to one cannot form a loop
+    std::vector<class PathItem> alternates;
 
     ForwardingTableItem() = default;
     ForwardingTableItem(std::string n, double m, int s) : nextHop(n), metric(m), seqNum(s) {}
@@ -40,9 +70,82 @@ public:
     //std::string name;
     double metric;
     int port;
+    // destination address of port, computed once
+    struct sockaddr_in addr;
 
     NeighborInfo() = default;
-    NeighborInfo(double m, int p) : metric(m), port(p) {}
+    NeighborInfo(double m, int p) : metric(m), port(p), addr(socketAddress(p)) {}
+};
+
+// immutable copy of the forwarding table published to readers
+class TableSnapshot {
+public:
+    unsigned long version;
+    std::map<std::string, class ForwardingTableItem> forwardingTable;
+    std::map<std::string, class NeighborInfo> neighborhood;
+    // sequence number border hosts originate the summary of their zone with
+    int zoneSeqNum;
+    // addresses of the neighbors reachable at this version
+    std::vector<struct sockaddr_in> neighbors;
+};
+
+// packets to send to every live neighbor, neighbors share one packet when no horizon rule applies
+class Advertisements {
+public:
+    std::vector<std::string> packets;
+    // <neighbor name, index into packets>
+    std::vector<std::pair<std::string, int> > neighbors;
+    std::vector<struct sockaddr_in> addrs;
+
+    void clear() {
+        packets.clear();
+        neighbors.clear();
+        addrs.clear();
+    }
+};
+
+// length of the zone prefix of a host name "zone.host", 0 if it has no dot
+inline size_t zoneLength(const std::string &name) {
+    auto dot = name.find('.');
+    return (dot == std::string::npos) ? 0 : dot;
+}
+
+// a summary route "zone.*" stands for every host of a zone
+inline bool isSummary(const std::string &name) {
+    return (name.size() >= 2) && (name[name.size() - 2] == '.') && (name[name.size() - 1] == '*');
+}
+
+// routes of a batch of advertisements, parsed without holding the lock and merged under it in one pass
+class MergeBatch {
+public:
+    class Route {
+    public:
+        // destination in keys
+        uint32_t offset;
+        uint32_t length;
+        // index into senders
+        uint32_t sender;
+        // as advertised, without the distance to the sender
+        double metric;
+        int seqNum;
+    };
+
+    // destination and sender names packed together, storage is reused by every batch
+    std::vector<char> keys;
+    // <offset, length> of each advertisement's sender in keys
+    std::vector<std::pair<uint32_t, uint32_t> > senders;
+    std::vector<Route> routes;
+
+    void clear();
+
+    // append the routes of one advertisement, false if it is malformed
+    bool parse(const char *buf, size_t len);
+
+    // group the routes by destination, keeping their arrival order within a group
+    void sort();
+
+private:
+    uint32_t append(const char *str, size_t len);
 };
 
 class MobileHost {
@@ -50,22 +153,131 @@ public:
     std::string name;
     int port;
     int seqNum;
+    // HORIZON_NONE, HORIZON_SPLIT (omit routes learned from the recipient) or HORIZON_POISON (advertise them as MAX)
+    int horizon;
+    // keep host routes only inside our zone and one summary route per other zone
+    bool zoning;
+    // prefix of name before the first dot, empty if it has none
+    std::string zone;
+    // sequence number of the summary of our zone: the highest any host advertised for it, rounded up
+    // to even, shared by every host of the zone so that its border hosts originate the same one
+    int zoneSeqNum;
+    // next hops kept per destination, from 1 to MAX_PATHS
+    int paths;
+    // MODE_DV, or MODE_LS which floods LSAs and fills forwardingTable by shortest path first
+    int mode;
+    // link-state database and shortest path tree, link-state mode only
+    class LinkState linkState;
+    // LSAs, table requests and answers to send, filled under the mutex and drained by whoever sends
+    class Advertisements outbox;
     // <key, value> ==> <name, port>
     std::map<std::string, class NeighborInfo> neighborhood;
     // <key, value> ==> <name, info>
+    // working copy, only touched by the writer under the global mutex
     std::map<std::string, class ForwardingTableItem> forwardingTable;
+    // routes added or whose next hop or cost changed by merging advertisements, written by the writer only
+    unsigned long changes;
 
-    MobileHost(std::string n, int p) : name(n), port(p), seqNum(0) {}
+    MobileHost(std::string n, int p) : name(n), port(p), seqNum(0), horizon(HORIZON_NONE), zoning(false),
+        zone(n, 0, zoneLength(n)), zoneSeqNum(0), paths(1), mode(MODE_DV),
+        changes(0), version(0), dirty(true) {
+        linkState.setSelf(n);
+    }
+
+    // publish the working copy as the next snapshot if it changed since the last one, true if it did
+    bool publish();
+
+    // lock-free read of the current snapshot, valid as long as the guard lives
+    RcuPointer<class TableSnapshot>::ReadGuard snapshot() const;
+
+    // look up a destination in the current snapshot
+    bool lookup(const std::string &destination, class ForwardingTableItem &item) const;
 
     std::string serialize();
 
+    // cut into segments of segmentSize bytes, smaller when they go out behind another header
+    void advertise(class Advertisements &ads, size_t segmentSize = SEGMENT_SIZE);
+
     std::map<std::string, class RouteTableItem> deserialize(const std::string &str, std::string &nextHop);
 
-    void updateForwardingTable(const std::string &nextHop, const std::map<std::string, class RouteTableItem> &routeTable);
+    bool updateForwardingTable(const std::string &nextHop, const std::map<std::string, class RouteTableItem> &routeTable);
+
+    bool mergeAdvertisement(const char *buf, size_t len);
+
+    // merge only the newest, then shortest, route to every destination of a sorted batch
+    bool mergeAdvertisements(const class MergeBatch &batch);
+
+    bool updateNeighbor(const std::string &neighborName, double neighborMetric, int neighborPort);
+
+    bool applyNeighborInfo(const std::map<std::string, class NeighborInfo> &neighbors);
 
     bool refreshNeighborInfo(const std::string &filename);
 
-    void printOut();
+    // routes through a neighbor that stopped advertising fail over or become unreachable,
+    // return the number of routes aged
+    int ageRoutes(const std::string &neighborName);
+
+    void printOut(std::ostream &out = std::cout);
+
+    // flood a new LSA of our links, after the neighborhood changed or to refresh it
+    void originate();
+
+    // install and flood an LSA once all of its segments arrived if it is newer than ours, return true if
+    // any route changed
+    bool receiveLsa(const char *buf, size_t len);
+
+    // ask a neighbor that came up for its whole table
+    void request(const std::string &neighborName);
+
+    // append our whole table (our link-state database in link-state mode) for a live neighbor that
+    // requested it to ads, from the published snapshot, in segments of segmentSize bytes
+    void answer(const std::string &neighborName, class Advertisements &ads, size_t segmentSize = SEGMENT_SIZE);
+
+private:
+    RcuPointer<class TableSnapshot> current;
+    unsigned long version;
+    bool dirty;
+    // scratch keys of mergeAdvertisement, their storage is reused by every advertisement
+    std::string mergeNextHop;
+    std::string mergeDestination;
+    // distance to each sender of the batch being merged, negative if it is not a neighbor
+    std::vector<double> mergeDistances;
+
+    bool mergeRoute(const std::string &destination, const std::string &nextHop, double distance,
+            double metric, int sequence);
+
+    // a route whose next hop failed and has no alternate becomes unreachable
+    void breakRoute(const std::string &destination, class ForwardingTableItem &item);
+
+    void mergeAlternate(class ForwardingTableItem &item, const std::string &nextHop, double reported, double metric);
+
+    bool failover(class ForwardingTableItem &item);
+
+    // hosts touched by the last shortest path update
+    std::vector<int> touched;
+
+    // LSAs that still miss some of their segments, by origin
+    std::map<int, class LsaSegments> lsaSegments;
+
+    void flood(int origin, const std::string &except);
+
+    // the LSA of origin as we forward it, appended to packets as segments of at most segmentSize bytes
+    // that each carry their part of the links, so a lost one never leaves a truncated LSA behind
+    void lsa(int origin, size_t segmentSize, std::vector<std::string> &packets);
+
+    bool updateRoutes();
+
+    void updateAlternates(class ForwardingTableItem &item, const std::string &neighborName, double neighborMetric);
+
+    bool sameZone(const std::string &destination) const;
 };
 
+// HORIZON_* of "none", "split" or "poison", -1 if invalid
+int parseHorizon(const std::string &str);
+
+// MODE_* of "dv" or "ls", -1 if invalid
+int parseMode(const std::string &str);
+
+bool loadNeighborFile(const std::string &filename, std::string &name, std::map<std::string, class NeighborInfo> &neighbors);
+
 #endif
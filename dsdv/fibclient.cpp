@@ -0,0 +1,116 @@
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <cstring>
+#include "fibclient.h"
+
+static const char MAGIC[8] = {'D', 'S', 'D', 'V', 'F', 'I', 'B', '1'};
+
+uint64_t fibHash(const char *key, size_t len) {
+    // FNV-1a
+    uint64_t h = 14695981039346656037ull;
+    for (size_t i = 0; i < len; ++i) {
+        h ^= static_cast<unsigned char>(key[i]);
+        h *= 1099511628211ull;
+    }
+    return h;
+}
+
+std::string fibName(int port) {
+    return "/dsdv-fib-" + std::to_string(port);
+}
+
+FibClient::~FibClient() {
+    if (base) {
+        munmap(base, length);
+    }
+    if (fd >= 0) {
+        close(fd);
+    }
+}
+
+bool FibClient::open(const std::string &name) {
+    fd = shm_open(name.c_str(), O_RDONLY | O_CLOEXEC, 0);
+    if (fd < 0) {
+        return false;
+    }
+    if ((!remap()) || (memcmp(header()->magic, MAGIC, sizeof(MAGIC)) != 0)) {
+        return false;
+    }
+    return true;
+}
+
+bool FibClient::remap() {
+    struct stat st;
+    if ((fstat(fd, &st) < 0) || (static_cast<size_t>(st.st_size) < sizeof(FibHeader))) {
+        return false;
+    }
+    if (base) {
+        munmap(base, length);
+    }
+    base = static_cast<char *>(mmap(NULL, st.st_size, PROT_READ, MAP_SHARED, fd, 0));
+    if (base == MAP_FAILED) {
+        base = nullptr;
+        length = 0;
+        return false;
+    }
+    length = st.st_size;
+    return true;
+}
+
+bool FibClient::lookup(const char *destination, size_t len, FibRoute &route) {
+    if (!base) {
+        return false;
+    }
+    auto h = fibHash(destination, len);
+    for (;;) {
+        auto &buffer = header()->buffers[header()->active.load(std::memory_order_acquire)];
+        auto seq = buffer.seq.load(std::memory_order_acquire);
+        if (seq % 2 != 0) {
+            continue;
+        }
+        auto offset = buffer.offset, size = buffer.length;
+        if ((size < sizeof(FibTable)) || (offset + size > length)) {
+            // the table moved past our mapping, or was never written
+            if ((header()->size.load(std::memory_order_acquire) > length) && (remap())) {
+                continue;
+            }
+            return false;
+        }
+
+        // everything read below may be torn by the writer, so it is only trusted if seq did not move,
+        // and bounds are checked against the table so that garbage cannot lead outside of it
+        auto table = reinterpret_cast<const FibTable *>(base + offset);
+        auto slots = table->slots;
+        auto records = reinterpret_cast<const FibRecord *>(table + 1);
+        auto keys = reinterpret_cast<const char *>(records + slots);
+        auto keysLength = table->keys;
+        bool found = false, valid = (slots > 0) && ((slots & (slots - 1)) == 0) &&
+            (sizeof(FibTable) + slots * sizeof(FibRecord) + keysLength <= size);
+        for (uint32_t i = 0, slot = h & (slots - 1); (valid) && (i < slots); ++i, slot = (slot + 1) & (slots - 1)) {
+            const auto &record = records[slot];
+            if (record.length == 0) {
+                break;
+            }
+            if ((record.hash == h) && (record.length == len) && (record.offset + len <= keysLength) &&
+                    (memcmp(keys + record.offset, destination, len) == 0)) {
+                memcpy(route.nextHop, record.nextHop, FIB_NAME);
+                route.metric = record.metric;
+                route.seqNum = record.seqNum;
+                found = true;
+                break;
+            }
+        }
+
+        std::atomic_thread_fence(std::memory_order_acquire);
+        if ((valid) && (buffer.seq.load(std::memory_order_relaxed) == seq)) {
+            route.nextHop[FIB_NAME - 1] = '\0';
+            return found;
+        }
+    }
+}
+
+uint64_t FibClient::generation() const {
+    return base ? header()->generation.load(std::memory_order_acquire) : 0;
+}
@@ -0,0 +1,104 @@
+#ifndef FIBCLIENT_H_
+#define FIBCLIENT_H_
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+// layout of the forwarding table a host publishes in shared memory, and the client that reads it;
+// this header and fibclient.cpp only depend on the C library, so applications link libdsdvfib.a alone
+
+// next hop names are stored in fixed width fields, routes through longer names are not published
+const int FIB_NAME = 32;
+
+// one route of a published table, open addressing by hash with linear probing
+class FibRecord {
+public:
+    uint64_t hash;
+    // destination in the key pool of the table, an empty slot has length 0
+    uint32_t offset;
+    uint32_t length;
+    char nextHop[FIB_NAME];
+    double metric;
+    int32_t seqNum;
+    int32_t reserved;
+};
+
+// start of a published table, followed by slots records and then the key pool
+class FibTable {
+public:
+    // a power of two
+    uint32_t slots;
+    uint32_t routes;
+    uint64_t keys;
+};
+
+// where one of the two tables lives, guarded by a seqlock: odd while the table is written
+class FibBuffer {
+public:
+    std::atomic<uint64_t> seq;
+    uint64_t offset;
+    uint64_t length;
+};
+
+class FibHeader {
+public:
+    char magic[8];
+    // bytes of the shared object, a client whose mapping is smaller maps it again
+    std::atomic<uint64_t> size;
+    // number of tables published, changes whenever a route does
+    std::atomic<uint64_t> generation;
+    // the table to read, the writer always fills the other one
+    std::atomic<uint32_t> active;
+    uint32_t reserved;
+    FibBuffer buffers[2];
+};
+
+// hash of a destination name in the published tables
+uint64_t fibHash(const char *key, size_t len);
+
+// shared memory object of the host bound to port
+std::string fibName(int port);
+
+// a route as seen by a client, copied out of shared memory
+class FibRoute {
+public:
+    char nextHop[FIB_NAME];
+    double metric;
+    int32_t seqNum;
+};
+
+// read-only view of the table a host publishes: lookups take no lock and make no system call,
+// they copy the route and retry if the host rewrote the table meanwhile
+class FibClient {
+public:
+    FibClient() : fd(-1), base(nullptr), length(0) {}
+    ~FibClient();
+
+    // map the shared memory object name, as given to the host with -F or fibName(port)
+    bool open(const std::string &name);
+
+    // the route to destination, false if the host has none (unreachable routes have metric MAX)
+    bool lookup(const char *destination, size_t len, FibRoute &route);
+    bool lookup(const std::string &destination, FibRoute &route) {
+        return lookup(destination.data(), destination.size(), route);
+    }
+
+    // number of tables published so far, a changed value means some route may have changed
+    uint64_t generation() const;
+
+private:
+    int fd;
+    char *base;
+    size_t length;
+
+    FibHeader *header() const { return reinterpret_cast<FibHeader *>(base); }
+    // map the object again after it grew
+    bool remap();
+
+    FibClient(const FibClient &) = delete;
+    FibClient &operator=(const FibClient &) = delete;
+};
+
+#endif
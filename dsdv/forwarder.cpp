@@ -0,0 +1,173 @@
+#include "forwarder.h"
+
+size_t dataHeader(char *buf, const std::string &destination, uint16_t flow, int ttl) {
+    buf[0] = PKT_DATA;
+    buf[1] = ttl;
+    memcpy(buf + 2, &flow, sizeof(flow));
+    buf[4] = destination.size();
+    memcpy(buf + DATA_HEADER, destination.data(), destination.size());
+    return DATA_HEADER + destination.size();
+}
+
+void Fib::build(const std::string &self, const class TableSnapshot &snapshot, std::map<std::string, int> &ids) {
+    version = snapshot.version;
+
+    // at most half full, so probe sequences stay short
+    size_t size = 8;
+    while (size < 2 * snapshot.forwardingTable.size()) {
+        size <<= 1;
+    }
+    mask = size - 1;
+    Entry empty;
+    memset(&empty, 0, sizeof(Entry));
+    empty.counter = -1;
+    slots.assign(size, empty);
+    keys.clear();
+
+    for (const auto &it : snapshot.forwardingTable) {
+        if (it.second.metric >= MAX) {
+            continue;
+        }
+        Entry e = empty;
+        e.local = (it.first == self);
+        if (!e.local) {
+            auto neighbor = snapshot.neighborhood.find(it.second.nextHop);
+            if ((neighbor == snapshot.neighborhood.end()) || (neighbor->second.metric >= MAX)) {
+                continue;
+            }
+            e.nextHops[e.paths++] = neighbor->second.addr;
+            // alternates are sorted, those as short as the primary share its traffic
+            for (const auto &alternate : it.second.alternates) {
+                neighbor = snapshot.neighborhood.find(alternate.nextHop);
+                if ((alternate.metric != it.second.metric) || (e.paths == MAX_PATHS)) {
+                    break;
+                }
+                if ((neighbor != snapshot.neighborhood.end()) && (neighbor->second.metric < MAX)) {
+                    e.nextHops[e.paths++] = neighbor->second.addr;
+                }
+            }
+        }
+        if (ids.find(it.first) == ids.end()) {
+            auto id = ids.size();
+            ids[it.first] = id;
+        }
+        e.counter = ids[it.first];
+        e.offset = keys.size();
+        e.length = it.first.size();
+        e.hash = hash(it.first.data(), it.first.size());
+        keys.insert(keys.end(), it.first.begin(), it.first.end());
+
+        auto i = e.hash & mask;
+        while (slots[i].counter >= 0) {
+            i = (i + 1) & mask;
+        }
+        slots[i] = e;
+    }
+}
+
+const Fib::Entry *Fib::lookup(const char *destination, size_t len) const {
+    auto h = hash(destination, len);
+    for (auto i = h & mask; slots[i].counter >= 0; i = (i + 1) & mask) {
+        const auto &e = slots[i];
+        if ((e.hash == h) && (e.length == len) && (memcmp(&keys[e.offset], destination, len) == 0)) {
+            return &e;
+        }
+    }
+    return nullptr;
+}
+
+// 64-bit FNV-1a
+uint64_t Fib::hash(const char *key, size_t len) {
+    uint64_t h = 14695981039346656037ULL;
+    for (size_t i = 0; i < len; ++i) {
+        h ^= static_cast<unsigned char>(key[i]);
+        h *= 1099511628211ULL;
+    }
+    return h;
+}
+
+void Forwarder::refresh() {
+    auto snapshot = host->snapshot();
+    if (snapshot->version == fib.version) {
+        return;
+    }
+
+    std::lock_guard<std::mutex> lock(mutex);
+    fib.build(host->name, *snapshot, ids);
+    counters.resize(ids.size());
+}
+
+void Forwarder::forward(char *buf, size_t len) {
+    if ((len < DATA_HEADER) || (len < DATA_HEADER + static_cast<unsigned char>(buf[4]))) {
+        dropOne();
+        return;
+    }
+
+    auto entry = fib.lookup(buf + DATA_HEADER, static_cast<unsigned char>(buf[4]));
+    if (!entry) {
+        // hosts of other zones are reached through the summary route of their zone
+        entry = summary(buf + DATA_HEADER, static_cast<unsigned char>(buf[4]));
+    }
+    if (!entry) {
+        dropOne();
+        return;
+    }
+    counters[entry->counter].add(len);
+    if (entry->local) {
+        return;
+    }
+
+    auto ttl = static_cast<unsigned char>(buf[1]);
+    if (ttl <= 1) {
+        dropOne();
+        return;
+    }
+    buf[1] = ttl - 1;
+    uint16_t flow;
+    memcpy(&flow, buf + 2, sizeof(flow));
+    batch.add(entry->nextHop(flow), buf, len);
+}
+
+void Forwarder::flush(int fd) {
+    if (batch.size() > 0) {
+        socketSendBatch(fd, batch);
+    }
+}
+
+void Forwarder::printOut(std::ostream &out) {
+    std::lock_guard<std::mutex> lock(mutex);
+    unsigned long total = 0;
+    for (const auto &it : counters) {
+        total += it.packets.load(std::memory_order_relaxed);
+    }
+    if ((total == 0) && (dropped.load(std::memory_order_relaxed) == 0)) {
+        return;
+    }
+
+    out << "## data plane: " << dropped.load(std::memory_order_relaxed) << " packets dropped" << std::endl;
+    for (const auto &it : ids) {
+        const auto &counter = counters[it.second];
+        if (counter.packets.load(std::memory_order_relaxed) == 0) {
+            continue;
+        }
+        out << "destination " << it.first << ": " << counter.packets.load(std::memory_order_relaxed)
+            << " packets, " << counter.bytes.load(std::memory_order_relaxed) << " bytes" << std::endl;
+    }
+}
+
+const Fib::Entry *Forwarder::summary(const char *destination, size_t len) const {
+    auto dot = static_cast<const char *>(memchr(destination, '.', len));
+    if (!dot) {
+        return nullptr;
+    }
+    // "zone.host" ==> "zone.*", a name is at most 255 bytes
+    char key[258];
+    size_t prefix = dot - destination + 1;
+    memcpy(key, destination, prefix);
+    key[prefix] = '*';
+    return fib.lookup(key, prefix + 1);
+}
+
+void Forwarder::dropOne() {
+    dropped.store(dropped.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+}
@@ -0,0 +1,108 @@
+#ifndef FORWARDER_H_
+#define FORWARDER_H_
+
+#include <atomic>
+#include <cstdint>
+#include "dsdv.h"
+
+// first byte of a data datagram, advertisements always start with a printable host name
+const char PKT_DATA = 0x01;
+
+// data datagram layout:
+// | type (1) | ttl (1) | flow (2) | destination length (1) | destination | payload |
+const size_t DATA_HEADER = 5;
+const int DATA_TTL = 64;
+
+// build the header of a data datagram in buf, return its length
+size_t dataHeader(char *buf, const std::string &destination, uint16_t flow, int ttl = DATA_TTL);
+
+// packets and bytes forwarded to or delivered at one destination, written by the forwarding thread only
+class FlowCounter {
+public:
+    std::atomic<unsigned long> packets;
+    std::atomic<unsigned long> bytes;
+
+    FlowCounter() : packets(0), bytes(0) {}
+    FlowCounter(const FlowCounter &c) : packets(c.packets.load()), bytes(c.bytes.load()) {}
+
+    void add(size_t len) {
+        packets.store(packets.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+        bytes.store(bytes.load(std::memory_order_relaxed) + len, std::memory_order_relaxed);
+    }
+};
+
+// forwarding information base compiled from a table snapshot for fast lookups:
+// open addressing with linear probing, keys packed in one character pool
+class Fib {
+public:
+    class Entry {
+    public:
+        uint64_t hash;
+        uint32_t offset;
+        uint32_t length;
+        // delivered locally instead of forwarded
+        bool local;
+        // index into the forwarder's per-destination counters
+        int counter;
+        // equal-cost next hops, flows are spread over them by hash
+        int paths;
+        struct sockaddr_in nextHops[MAX_PATHS];
+
+        const struct sockaddr_in &nextHop(uint16_t flow) const {
+            return nextHops[(paths == 1) ? 0 : (((flow * 0x9E3779B1u) >> 16) % paths)];
+        }
+    };
+
+    unsigned long version;
+
+    Fib() : version(0), mask(0) {}
+
+    // compile every reachable route of snapshot, ids assigns a stable counter index to each destination
+    void build(const std::string &self, const class TableSnapshot &snapshot, std::map<std::string, int> &ids);
+
+    // entry for destination, or nullptr if unreachable
+    const Entry *lookup(const char *destination, size_t len) const;
+
+    static uint64_t hash(const char *key, size_t len);
+
+private:
+    std::vector<Entry> slots;
+    std::vector<char> keys;
+    uint64_t mask;
+};
+
+// relays data datagrams hop by hop, owned by the receiving thread
+class Forwarder {
+public:
+    // per destination, indexed by Fib::Entry::counter
+    std::vector<class FlowCounter> counters;
+    std::map<std::string, int> ids;
+    std::atomic<unsigned long> dropped;
+
+    Forwarder(MobileHost *h) : dropped(0), host(h) {}
+
+    // compile the FIB again if the control plane published a new version since the last call
+    void refresh();
+
+    // forward or deliver one data datagram, the ttl is decremented in place so buf must
+    // stay valid until flush()
+    void forward(char *buf, size_t len);
+
+    // send everything forwarded since the last flush with one system call
+    void flush(int fd);
+
+    void printOut(std::ostream &out = std::cout);
+
+private:
+    MobileHost *host;
+    class Fib fib;
+    class SendBatch batch;
+    // held while counters grows and while they are printed, never by forward()
+    std::mutex mutex;
+
+    void dropOne();
+    // FIB entry of the summary route of destination's zone
+    const Fib::Entry *summary(const char *destination, size_t len) const;
+};
+
+#endif
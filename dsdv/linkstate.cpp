@@ -0,0 +1,326 @@
+#include <algorithm>
+#include <functional>
+#include "dsdv.h"
+
+typedef std::pair<double, int> HeapItem;
+
+int LinkState::id(const std::string &name) {
+    auto it = ids.find(name);
+    if (it != ids.end()) {
+        return it->second;
+    }
+
+    int ret = names.size();
+    ids[name] = ret;
+    names.push_back(name);
+    seqNums.push_back(-1);
+    links.push_back(Links());
+    dist.push_back(UNREACHABLE);
+    parent.push_back(-1);
+    firstHop.push_back(-1);
+    return ret;
+}
+
+void LinkState::setSelf(const std::string &name) {
+    self = id(name);
+    rebuild = true;
+}
+
+double LinkState::weight(int u, int v) const {
+    for (const auto &it : links[u]) {
+        if (it.first != v) {
+            continue;
+        }
+        for (const auto &back : links[v]) {
+            if (back.first == u) {
+                return it.second;
+            }
+        }
+        break;
+    }
+    return UNREACHABLE;
+}
+
+bool LinkState::install(int origin, int seqNum, const Links &next) {
+    if (seqNum <= seqNums[origin]) {
+        return false;
+    }
+
+    // both directions of every link of origin may change, since a link needs both ends
+    const Links *sides[] = {&links[origin], &next};
+    for (auto side : sides) {
+        for (const auto &it : *side) {
+            pending.push_back(std::make_pair(std::make_pair(origin, it.first), weight(origin, it.first)));
+            pending.push_back(std::make_pair(std::make_pair(it.first, origin), weight(it.first, origin)));
+        }
+    }
+    seqNums[origin] = seqNum;
+    links[origin] = next;
+    return true;
+}
+
+void LinkState::update(std::vector<int> &touched) {
+    touched.clear();
+    if ((rebuild) || (self < 0)) {
+        full(touched);
+        pending.clear();
+        rebuild = false;
+        return;
+    }
+
+    // hosts below a tree link that got longer lose their distance: 1 inside such a subtree, 2 outside
+    std::vector<char> state(names.size(), 0);
+    bool invalid = false;
+    for (const auto &it : pending) {
+        auto u = it.first.first, v = it.first.second;
+        if ((weight(u, v) > it.second) && (parent[v] == u)) {
+            state[v] = 1;
+            invalid = true;
+        }
+    }
+
+    std::vector<HeapItem> heap;
+    if (invalid) {
+        std::vector<int> chain;
+        state[self] = (state[self] == 0) ? 2 : state[self];
+        for (size_t x = 0; x < names.size(); ++x) {
+            // walk up until the state of an ancestor is known
+            auto y = static_cast<int>(x);
+            while ((y >= 0) && (state[y] == 0)) {
+                chain.push_back(y);
+                y = parent[y];
+            }
+            auto known = (y < 0) ? 2 : state[y];
+            for (auto z : chain) {
+                state[z] = known;
+            }
+            chain.clear();
+        }
+
+        std::vector<int> lost;
+        for (size_t x = 0; x < names.size(); ++x) {
+            if ((state[x] == 1) && (static_cast<int>(x) != self)) {
+                dist[x] = UNREACHABLE;
+                parent[x] = -1;
+                firstHop[x] = -1;
+                lost.push_back(x);
+                touched.push_back(x);
+            }
+        }
+        // start again from the best neighbor outside the lost subtrees, links are symmetric in who lists them
+        for (auto x : lost) {
+            for (const auto &it : links[x]) {
+                if ((state[it.first] != 1) && (dist[it.first] < UNREACHABLE)) {
+                    improve(it.first, x, heap);
+                }
+            }
+        }
+    }
+
+    for (const auto &it : pending) {
+        if (weight(it.first.first, it.first.second) < it.second) {
+            improve(it.first.first, it.first.second, heap);
+        }
+    }
+    pending.clear();
+    relax(heap, touched);
+}
+
+void LinkState::full(std::vector<int> &touched) {
+    std::fill(dist.begin(), dist.end(), UNREACHABLE);
+    std::fill(parent.begin(), parent.end(), -1);
+    std::fill(firstHop.begin(), firstHop.end(), -1);
+    for (size_t x = 0; x < names.size(); ++x) {
+        touched.push_back(x);
+    }
+    if (self < 0) {
+        return;
+    }
+
+    std::vector<HeapItem> heap;
+    dist[self] = 0;
+    heap.push_back(HeapItem(0, self));
+    relax(heap, touched);
+}
+
+// Dijkstra from every host in heap, which only ever lowers distances
+void LinkState::relax(std::vector<HeapItem> &heap, std::vector<int> &touched) {
+    std::make_heap(heap.begin(), heap.end(), std::greater<HeapItem>());
+    while (!heap.empty()) {
+        std::pop_heap(heap.begin(), heap.end(), std::greater<HeapItem>());
+        auto top = heap.back();
+        heap.pop_back();
+        if (top.first > dist[top.second]) {
+            continue;
+        }
+        touched.push_back(top.second);
+        for (const auto &it : links[top.second]) {
+            improve(top.second, it.first, heap);
+        }
+    }
+}
+
+void LinkState::improve(int u, int v, std::vector<HeapItem> &heap) {
+    auto metric = dist[u] + weight(u, v);
+    if (metric >= dist[v]) {
+        return;
+    }
+    dist[v] = metric;
+    parent[v] = u;
+    firstHop[v] = (u == self) ? v : firstHop[u];
+    heap.push_back(HeapItem(metric, v));
+    std::push_heap(heap.begin(), heap.end(), std::greater<HeapItem>());
+}
+
+void MobileHost::originate() {
+    auto self = linkState.id(name);
+    LinkState::Links links;
+    for (const auto &it : neighborhood) {
+        if (it.second.metric < MAX) {
+            links.push_back(std::make_pair(linkState.id(it.first), it.second.metric));
+        }
+    }
+    linkState.install(self, linkState.seqNums[self] + 1, links);
+    flood(self, "");
+    updateRoutes();
+}
+
+bool MobileHost::receiveLsa(const char *buf, size_t len) {
+    // type -- sender -- origin -- seqNum -- segment -- segments -- count, then neighbor -- metric per link
+    std::istringstream sin(std::string(buf + 1, len - 1));
+    std::string sender, origin, neighbor;
+    int seqNum, segment, segments, count;
+    double metric;
+    if ((!(sin >> sender >> origin >> seqNum >> segment >> segments >> count)) || (count < 0) ||
+            (segment < 0) || (segment >= segments) || (segments > UINT16_MAX) || (neighborhood.find(sender) == neighborhood.end())) {
+        return false;
+    }
+    LinkState::Links links;
+    for (auto i = 0; i < count; ++i) {
+        if (!(sin >> neighbor >> metric)) {
+            return false;
+        }
+        links.push_back(std::make_pair(linkState.id(neighbor), metric));
+    }
+
+    auto id = linkState.id(origin);
+    if (seqNum < linkState.seqNums[id]) {
+        return false;
+    }
+    if (segments > 1) {
+        // the segments of a newer LSA replace those of an older one still incomplete
+        auto &pending = lsaSegments[id];
+        if ((pending.received.size() != static_cast<size_t>(segments)) || (pending.seqNum != seqNum)) {
+            pending.seqNum = seqNum;
+            pending.received.assign(segments, false);
+            pending.links.assign(segments, LinkState::Links());
+        }
+        pending.received[segment] = true;
+        pending.links[segment].swap(links);
+        if (std::find(pending.received.begin(), pending.received.end(), false) != pending.received.end()) {
+            return false;
+        }
+        for (const auto &it : pending.links) {
+            links.insert(links.end(), it.begin(), it.end());
+        }
+        lsaSegments.erase(id);
+    }
+    if (origin == name) {
+        // an LSA of ours from before a restart, ours must be newer
+        if ((seqNum > linkState.seqNums[id]) || ((seqNum == linkState.seqNums[id]) && (links != linkState.links[id]))) {
+            linkState.seqNums[id] = seqNum;
+            originate();
+        }
+        return false;
+    }
+    if (!linkState.install(id, seqNum, links)) {
+        return false;
+    }
+    flood(id, sender);
+    return updateRoutes();
+}
+
+void MobileHost::lsa(int origin, size_t segmentSize, std::vector<std::string> &packets) {
+    std::ostringstream sout;
+    sout << PKT_LSA << ' ' << name << ' ' << linkState.names[origin] << ' ' << linkState.seqNums[origin] << ' ';
+    auto prefix = sout.str();
+    // room for the segment numbers and the count that follow the prefix, five digits and a space each
+    auto room = (segmentSize > prefix.size() + 18) ? (segmentSize - prefix.size() - 18) : 0;
+
+    // the links as "neighbor metric " grouped into the bodies of the segments, at least one
+    std::vector<std::pair<std::string, int> > bodies(1);
+    std::string link;
+    for (const auto &it : linkState.links[origin]) {
+        sout.str("");
+        sout << linkState.names[it.first] << ' ' << it.second << ' ';
+        link = sout.str();
+        if (link.size() > room) {
+            // a link that does not even fit an empty segment cannot be sent
+            continue;
+        }
+        if (bodies.back().first.size() + link.size() > room) {
+            bodies.push_back(std::make_pair(std::string(), 0));
+        }
+        bodies.back().first.append(link);
+        ++bodies.back().second;
+    }
+
+    for (size_t i = 0; i < bodies.size(); ++i) {
+        packets.push_back(prefix);
+        packets.back().append(std::to_string(i)).append(" ").append(std::to_string(bodies.size())).append(" ")
+            .append(std::to_string(bodies[i].second)).append(" ").append(bodies[i].first);
+    }
+}
+
+void MobileHost::flood(int origin, const std::string &except) {
+    auto first = outbox.packets.size();
+    lsa(origin, SEGMENT_SIZE, outbox.packets);
+    for (const auto &it : neighborhood) {
+        if ((it.second.metric < MAX) && (it.first != except)) {
+            for (auto packet = first; packet < outbox.packets.size(); ++packet) {
+                outbox.neighbors.push_back(std::make_pair(it.first, static_cast<int>(packet)));
+                outbox.addrs.push_back(it.second.addr);
+            }
+        }
+    }
+}
+
+// copy the routes the last update touched from the tree into the forwarding table
+bool MobileHost::updateRoutes() {
+    linkState.update(touched);
+    bool changed = false;
+    for (auto x : touched) {
+        const auto &destination = linkState.names[x];
+        if (destination == name) {
+            continue;
+        }
+        auto entry = forwardingTable.find(destination);
+        if (linkState.dist[x] == UNREACHABLE) {
+            if ((entry != forwardingTable.end()) && (entry->second.metric < MAX)) {
+                entry->second.metric = MAX;
+                changed = true;
+                ++changes;
+            }
+            continue;
+        }
+
+        const auto &nextHop = linkState.names[linkState.firstHop[x]];
+        auto metric = linkState.dist[x];
+        if (entry == forwardingTable.end()) {
+            forwardingTable[destination] = ForwardingTableItem(nextHop, metric, linkState.seqNums[x]);
+            changed = true;
+            ++changes;
+        } else if ((entry->second.nextHop != nextHop) || (entry->second.metric != metric)) {
+            entry->second.nextHop.assign(nextHop);
+            entry->second.metric = metric;
+            entry->second.seqNum = linkState.seqNums[x];
+            changed = true;
+            ++changes;
+        }
+    }
+
+    if (changed) {
+        dirty = true;
+    }
+    return changed;
+}
@@ -0,0 +1,77 @@
+#ifndef LINKSTATE_H_
+#define LINKSTATE_H_
+
+#include <string>
+#include <vector>
+#include <map>
+#include <limits>
+
+// first byte of a segment of a link-state advertisement, followed by the sender, the origin, its
+// sequence number, the number of the segment and of segments, the number of links in this segment
+// and a neighbor and metric per link
+const char PKT_LSA = 0x02;
+
+// our own LSA is flooded again every LSA_REFRESH periods even if it did not change, to repair losses
+const int LSA_REFRESH = 6;
+
+// distance of hosts that cannot be reached
+const double UNREACHABLE = std::numeric_limits<double>::infinity();
+
+// link-state database and shortest path tree of one host: every origin's LSA lists its links,
+// a link is only used if both of its ends list it
+class LinkState {
+public:
+    // <neighbor id, metric>
+    typedef std::vector<std::pair<int, double> > Links;
+
+    // everything below is indexed by host id
+    std::vector<std::string> names;
+    // sequence number of the installed LSA, -1 if none arrived yet
+    std::vector<int> seqNums;
+    std::vector<Links> links;
+    // shortest path tree rooted at self
+    std::vector<double> dist;
+    std::vector<int> parent;
+    // neighbor of self the path to a host starts with, -1 for self and unreachable hosts
+    std::vector<int> firstHop;
+
+    LinkState() : self(-1), rebuild(true) {}
+
+    // the id of name, assigned when first seen
+    int id(const std::string &name);
+
+    void setSelf(const std::string &name);
+
+    // replace the LSA of origin if seqNum is newer than the installed one, return true if it was
+    bool install(int origin, int seqNum, const Links &next);
+
+    // bring the tree up to date with every LSA installed since the last call, touched gets
+    // the hosts whose distance or first hop may have changed
+    void update(std::vector<int> &touched);
+
+    // metric of the link from u to v, UNREACHABLE unless both list it
+    double weight(int u, int v) const;
+
+private:
+    int self;
+    // <from, to, metric before> of links whose metric changed since the last update
+    std::vector<std::pair<std::pair<int, int>, double> > pending;
+    // set when the tree must be computed from scratch
+    bool rebuild;
+    std::map<std::string, int> ids;
+
+    void full(std::vector<int> &touched);
+    void relax(std::vector<std::pair<double, int> > &heap, std::vector<int> &touched);
+    void improve(int u, int v, std::vector<std::pair<double, int> > &heap);
+};
+
+// the segments of one LSA received so far
+class LsaSegments {
+public:
+    int seqNum;
+    std::vector<bool> received;
+    // the links of each segment
+    std::vector<LinkState::Links> links;
+};
+
+#endif
@@ -0,0 +1,88 @@
+#include "liveness.h"
+
+void Liveness::heard(const std::string &name, bool advertised) {
+    auto now = std::chrono::steady_clock::now();
+    std::lock_guard<std::mutex> lock(mutex);
+    auto it = peers.find(name);
+    if (it == peers.end()) {
+        return;
+    }
+    it->second.lastHello = now;
+    if (advertised) {
+        it->second.lastAdvertisement = now;
+    }
+}
+
+void Liveness::configure(std::map<std::string, class NeighborInfo> &neighbors) {
+    auto now = std::chrono::steady_clock::now();
+    std::lock_guard<std::mutex> lock(mutex);
+    for (auto &it : neighbors) {
+        auto peer = peers.find(it.first);
+        if (peer == peers.end()) {
+            // new neighbors get HELLO_MISSES intervals to say hello
+            peer = peers.insert(std::make_pair(it.first, Peer())).first;
+            peer->second.alive = true;
+            peer->second.lastHello = now;
+            peer->second.lastAdvertisement = now;
+        }
+        peer->second.configured = it.second.metric;
+        peer->second.port = it.second.port;
+        if ((!peer->second.alive) && (it.second.metric >= 0)) {
+            it.second.metric = -1;
+        }
+    }
+}
+
+void Liveness::hello(const std::string &name, std::string &packet, std::vector<struct sockaddr_in> &addrs) {
+    packet.assign(1, PKT_HELLO);
+    packet.append(1, ' ');
+    packet.append(name);
+    addrs.clear();
+    std::lock_guard<std::mutex> lock(mutex);
+    for (const auto &it : peers) {
+        if (it.second.configured >= 0) {
+            addrs.push_back(socketAddress(it.second.port));
+        }
+    }
+}
+
+bool Liveness::check(MobileHost &host, int &failures, int &aged) {
+    auto now = std::chrono::steady_clock::now();
+    auto timeout = std::chrono::milliseconds(HELLO_MISSES * interval);
+    auto age = std::chrono::milliseconds(ROUTE_AGE_PERIODS * period);
+    std::map<std::string, class NeighborInfo> changed;
+    std::vector<std::string> silent;
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        for (auto &it : peers) {
+            auto &peer = it.second;
+            if (peer.configured < 0) {
+                continue;
+            }
+            auto heard = (now - peer.lastHello <= timeout);
+            if ((peer.alive) && (!heard)) {
+                // the same failure path as a negative metric in the neighbor file
+                peer.alive = false;
+                changed[it.first] = NeighborInfo(-1, peer.port);
+                ++failures;
+            } else if ((!peer.alive) && (heard)) {
+                peer.alive = true;
+                peer.lastAdvertisement = now;
+                changed[it.first] = NeighborInfo(peer.configured, peer.port);
+            } else if ((peer.alive) && (now - peer.lastAdvertisement > age)) {
+                // once per silent window, the routes are unreachable afterwards anyway
+                peer.lastAdvertisement = now;
+                silent.push_back(it.first);
+            }
+        }
+    }
+
+    auto ret = (!changed.empty()) && (host.applyNeighborInfo(changed));
+    // link-state routes do not come from periodic advertisements
+    if (host.mode == MODE_DV) {
+        for (const auto &it : silent) {
+            aged += host.ageRoutes(it);
+        }
+    }
+    return (ret) || (aged > 0);
+}
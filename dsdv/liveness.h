@@ -0,0 +1,59 @@
+#ifndef LIVENESS_H_
+#define LIVENESS_H_
+
+#include <chrono>
+#include <map>
+#include <mutex>
+#include <string>
+#include <vector>
+#include "dsdv.h"
+
+// first byte of a hello datagram, followed by a space and the name of its sender
+const char PKT_HELLO = 0x03;
+
+// a neighbor is declared dead after this many hello intervals without hearing from it
+const int HELLO_MISSES = 3;
+
+// routes through a live neighbor that sent no advertisement for this many periods are aged out
+const int ROUTE_AGE_PERIODS = 3;
+
+// neighbor liveness by hello datagrams, and aging of routes whose next hop stopped advertising
+class Liveness {
+public:
+    // hello interval in milliseconds, 0 disables hellos and aging
+    int interval;
+    // advertisement period of the host in milliseconds
+    int period;
+
+    Liveness() : interval(200), period(5000) {}
+
+    // note a datagram from a neighbor, advertised for its distance vector advertisements
+    void heard(const std::string &name, bool advertised);
+
+    // remember the links of the neighbor file, neighbors found dead keep metric -1 in it
+    void configure(std::map<std::string, class NeighborInfo> &neighbors);
+
+    // the hello of host and the address of every configured neighbor, dead or alive
+    void hello(const std::string &name, std::string &packet, std::vector<struct sockaddr_in> &addrs);
+
+    // take neighbors that went silent down and those heard again up, and age the routes of silent
+    // advertisers, under the global mutex; return true if host changed
+    bool check(MobileHost &host, int &failures, int &aged);
+
+private:
+    class Peer {
+    public:
+        // metric in the neighbor file, negative if the link is down there
+        double configured;
+        int port;
+        bool alive;
+        std::chrono::steady_clock::time_point lastHello;
+        std::chrono::steady_clock::time_point lastAdvertisement;
+    };
+
+    // guards peers, heard() is called by the receiver without the global mutex
+    std::mutex mutex;
+    std::map<std::string, Peer> peers;
+};
+
+#endif
@@ -0,0 +1,51 @@
+#include <chrono>
+#include <cstdlib>
+#include <iostream>
+#include <iomanip>
+#include "fibclient.h"
+
+// resolve destinations through the forwarding table a dsdv host publishes in shared memory
+int main(int argc, char *argv[]) {
+    long iterations = 1;
+    int first = 1;
+    if ((argc > 2) && (std::string(argv[1]) == "-n")) {
+        iterations = atol(argv[2]);
+        first = 3;
+    }
+    if ((argc - first < 2) || (iterations <= 0)) {
+        std::cout << "usage: " << argv[0] << " [-n iterations] <port|shared_fib> <destination>..." << std::endl;
+        exit(0);
+    }
+
+    std::string name(argv[first]);
+    if (name[0] != '/') {
+        name = fibName(atoi(argv[first]));
+    }
+    FibClient client;
+    if (!client.open(name)) {
+        std::cout << "cannot open " << name << std::endl;
+        exit(0);
+    }
+
+    std::cout << "generation " << client.generation() << std::endl;
+    for (auto i = first + 1; i < argc; ++i) {
+        std::string destination(argv[i]);
+        FibRoute route;
+        bool found = false;
+        auto begin = std::chrono::steady_clock::now();
+        for (long j = 0; j < iterations; ++j) {
+            found = client.lookup(destination, route);
+        }
+        std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - begin;
+        if (found) {
+            std::cout << destination << " next hop " << route.nextHop << " metric " << route.metric
+                << " seq " << route.seqNum;
+        } else {
+            std::cout << destination << " no route";
+        }
+        std::cout << ", " << setiosflags(std::ios::fixed) << std::setprecision(1)
+            << (elapsed.count() * 1e9 / iterations) << " ns per lookup" << std::endl;
+    }
+
+    return 0;
+}
@@ -1,80 +1,544 @@
+#include <getopt.h>
 #include "util.h"
 #include "dsdv.h"
+#include "watcher.h"
+#include "forwarder.h"
+#include "checkpoint.h"
+#include "stats.h"
+#include "liveness.h"
+#include "publisher.h"
+#include "transport.h"
+#include "sync.h"
+
+// how long the stats endpoint waits for a client to send its command or take the reply
+static const int STATS_TIMEOUT_MS = 500;
 
 std::mutex mutex;
+// wakes up the sender as soon as a link changes, guarded by mutex
+std::condition_variable trigger;
+bool triggered = false;
+// wakes up the sender to send only what is queued in the outbox, guarded by mutex
+bool answering = false;
+// written by whoever publishes, guarded by mutex
+Checkpoint checkpoint;
+FibPublisher fib;
+// OFFLOAD_* of the UDP socket, probed before any thread starts
+int offload = 0;
+// print the forwarding table every period, otherwise it is only queried through the stats endpoint
+bool printing = false;
+// hello state of the neighbors, guarded by its own mutex
+Liveness liveness;
+// answer table requests by reliable transfers, pushed by the syncing thread
+bool reliable = false;
+std::mutex syncMutex;
+// wakes up the syncing thread when a transfer starts or a window moves, guarded by syncMutex
+std::condition_variable syncTrigger;
+// one per thread, so recording never contends
+ThreadStats senderStats("sender"), receiverStats("receiver"), watcherStats("watcher"), livenessStats("liveness"),
+    syncStats("sync");
+
+// a new snapshot was published, bring the copies outside of the process up to date
+static void published(const MobileHost &host) {
+    checkpoint.save(host);
+    fib.save(host);
+}
 
-void sending(int fd, MobileHost *host, std::string filename) {
+void sending(int fd, MobileHost *host, Forwarder *forwarder, Transport *transport) {
+    // the periodic or triggered advertisement, and what others queued: LSAs, table requests and answers
+    Advertisements ads, queued;
+    SendBatch batch;
+    batch.gso = (offload & OFFLOAD_GSO);
+    // link-state hosts refresh their own LSA every LSA_REFRESH periods, starting with the first
+    int periods = 0;
+    bool refresh = true, round = true;
+    // the next periodic round, moved only by a round of advertisements
+    auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(5);
     for (;;) {
-        mutex.lock();
-        host->refreshNeighborInfo(filename);
-        host->seqNum += 2;
-        auto packet = host->serialize();
-        mutex.unlock();
-        host->printOut();
-        for (const auto &it : host->neighborhood) {
-            //std::cout << host->name << " is sending to port " << it.second.port << std::endl;
-            if (it.second.metric < MAX) {
-                socketSend(fd, it.second.port, packet);
+        Stopwatch watch;
+        {
+            // queued packets are produced by whoever holds the lock, the sender only takes them out
+            std::lock_guard<std::mutex> lock(mutex);
+            if ((host->mode == MODE_LS) && (refresh)) {
+                host->originate();
+                if (host->publish()) {
+                    published(*host);
+                    senderStats.counters[COUNT_PUBLISHED].add();
+                }
+            }
+            std::swap(queued, host->outbox);
+            host->outbox.clear();
+        }
+        // serializing and printing read the published snapshot, the writer's lock is not needed
+        ads.clear();
+        if (round) {
+            host->seqNum += 2;
+            if (host->mode == MODE_DV) {
+                host->advertise(ads);
+            }
+        }
+        senderStats.timers[TIMER_SERIALIZE].record(watch.elapsed());
+        if ((round) && (printing)) {
+            host->printOut();
+            forwarder->printOut();
+        }
+        // neighbors on this machine get the packets through their rings, the others by UDP
+        transport->check();
+        for (const auto *it : {&ads, &queued}) {
+            for (size_t i = 0; i < it->neighbors.size(); ++i) {
+                // advertisements are cut into independent segments, LSAs come as segments already
+                const auto &packet = it->packets[it->neighbors[i].second];
+                transport->send(batch, it->addrs[i], packet.data(), packet.size(), SEGMENT_SIZE);
+                senderStats.counters[COUNT_BYTES_SENT].add(packet.size());
+                senderStats.counters[COUNT_SENT].add((packet.size() + SEGMENT_SIZE - 1) / SEGMENT_SIZE);
+            }
+        }
+        watch.restart();
+        socketSendBatch(fd, batch);
+        senderStats.timers[TIMER_SEND].record(watch.elapsed());
+
+        // answers to table requests go out at once, without a round of advertisements to everybody and
+        // without postponing the next periodic one
+        std::unique_lock<std::mutex> lock(mutex);
+        trigger.wait_until(lock, deadline, [] { return triggered || answering; });
+        auto periodic = (std::chrono::steady_clock::now() >= deadline);
+        round = periodic || triggered;
+        refresh = periodic && (++periods % LSA_REFRESH == 0);
+        if (round) {
+            deadline = std::chrono::steady_clock::now() + std::chrono::seconds(5);
+        }
+        triggered = false;
+        answering = false;
+    }
+}
+
+void watching(MobileHost *host, std::string filename) {
+    FileWatcher watcher(filename);
+    for (;;) {
+        // the file is parsed without holding the lock, only the differences are applied under it
+        std::string name;
+        std::map<std::string, class NeighborInfo> neighbors;
+        if (loadNeighborFile(filename, name, neighbors)) {
+            // neighbors that went silent stay down whatever the file says
+            if (liveness.interval > 0) {
+                liveness.configure(neighbors);
+            }
+            std::lock_guard<std::mutex> lock(mutex);
+            Stopwatch held;
+            if (host->applyNeighborInfo(neighbors)) {
+                if (host->publish()) {
+                    published(*host);
+                    watcherStats.counters[COUNT_PUBLISHED].add();
+                }
+                triggered = true;
+                trigger.notify_one();
+            }
+            watcherStats.timers[TIMER_LOCK].record(held.elapsed());
+        }
+        watcher.wait(-1);
+    }
+}
+
+// send hellos every interval, then apply the neighbors that went silent or were heard again
+void beating(int fd, MobileHost *host) {
+    std::string packet;
+    std::vector<struct sockaddr_in> addrs;
+    for (;;) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(liveness.interval));
+        liveness.hello(host->name, packet, addrs);
+        socketBroadcast(fd, addrs, packet);
+
+        int failures = 0, aged = 0;
+        std::lock_guard<std::mutex> lock(mutex);
+        Stopwatch held;
+        if (liveness.check(*host, failures, aged)) {
+            if (host->publish()) {
+                published(*host);
+                livenessStats.counters[COUNT_PUBLISHED].add();
             }
+            // the failure is advertised at once, as if the neighbor file had changed
+            triggered = true;
+            trigger.notify_one();
         }
-        sleep(5);
+        livenessStats.timers[TIMER_LOCK].record(held.elapsed());
+        livenessStats.counters[COUNT_NEIGHBOR_FAILURES].add(failures);
+        livenessStats.counters[COUNT_ROUTES_AGED].add(aged);
     }
 }
 
-void receiving(int fd, MobileHost *host) {
+void receiving(int fd, MobileHost *host, Forwarder *forwarder, Transport *transport, SyncSender *syncSender) {
+    // datagrams are parsed in place into reused buffers, nothing is allocated per advertisement
+    ReceiveBatch batch((offload & OFFLOAD_GRO) ? GRO_BUFLEN : BUFLEN);
+    MergeBatch merge;
+    std::vector<int> lsas, requests;
+    // acknowledgements of reliable transfers to us, and acknowledgements of ours
+    SyncReceiver syncReceiver(host->name);
+    SendBatch acks;
+    std::vector<std::string> ackPackets;
+    std::vector<struct sockaddr_in> ackAddrs;
+    std::vector<SyncHeader> acked;
+    Advertisements answers;
+    SyncHeader header;
+    size_t offset;
     for (;;) {
-        std::string nextHop;
-        auto routeTable =  host->deserialize(socketReceive(fd), nextHop);
+        auto count = transport->receive(batch);
+        Stopwatch watch;
+        forwarder->refresh();
+        for (auto i = 0; i < count; ++i) {
+            if ((batch.size(i) > 0) && (batch.data(i)[0] == PKT_DATA)) {
+                forwarder->forward(batch.data(i), batch.size(i));
+            }
+        }
+        // data datagrams point into batch, so they go out before it is reused
+        forwarder->flush(fd);
+
+        // all pending advertisements are parsed and sorted by destination without the lock,
+        // then only the best route to each destination is merged under it
+        merge.clear();
+        lsas.clear();
+        requests.clear();
+        ackPackets.clear();
+        ackAddrs.clear();
+        acked.clear();
+        // the datagrams carried by reliable transfers are appended to the batch, so count grows
+        for (auto i = 0; i < batch.count; ++i) {
+            if ((batch.size(i) > 0) && (batch.data(i)[0] == PKT_SYNC_DATA)) {
+                auto snapshot = host->snapshot();
+                if (!parseSync(batch.data(i), batch.size(i), header, offset)) {
+                    continue;
+                }
+                auto sender = snapshot->neighborhood.find(header.sender);
+                if (sender == snapshot->neighborhood.end()) {
+                    continue;
+                }
+                ackPackets.push_back(std::string());
+                ackAddrs.push_back(sender->second.addr);
+                if (syncReceiver.receive(header, ackPackets.back())) {
+                    batch.add(batch.data(i) + offset, batch.size(i) - offset);
+                }
+            } else if ((batch.size(i) > 0) && (batch.data(i)[0] == PKT_SYNC_ACK)) {
+                if (parseSync(batch.data(i), batch.size(i), header, offset)) {
+                    acked.push_back(header);
+                }
+            } else if ((batch.size(i) > 2) && (batch.data(i)[0] == PKT_HELLO)) {
+                liveness.heard(std::string(batch.data(i) + 2, batch.size(i) - 2), false);
+            } else if ((batch.size(i) > 2) && (batch.data(i)[0] == PKT_REQUEST)) {
+                requests.push_back(i);
+            } else if ((batch.size(i) > 0) && (batch.data(i)[0] == PKT_LSA)) {
+                // LSAs are small and must be installed in order, they are parsed under the lock
+                lsas.push_back(i);
+                receiverStats.counters[COUNT_RECEIVED].add();
+                receiverStats.counters[COUNT_BYTES_RECEIVED].add(batch.size(i));
+            } else if ((batch.size(i) > 0) && (batch.data(i)[0] != PKT_DATA)) {
+                Stopwatch parsing;
+                merge.parse(batch.data(i), batch.size(i));
+                receiverStats.timers[TIMER_DESERIALIZE].record(parsing.elapsed());
+                receiverStats.counters[COUNT_RECEIVED].add();
+                receiverStats.counters[COUNT_BYTES_RECEIVED].add(batch.size(i));
+            }
+        }
+        if (liveness.interval > 0) {
+            for (const auto &it : merge.senders) {
+                liveness.heard(std::string(&merge.keys[it.first], it.second), true);
+            }
+        }
+        if (!ackPackets.empty()) {
+            for (size_t i = 0; i < ackPackets.size(); ++i) {
+                acks.add(ackAddrs[i], ackPackets[i].data(), ackPackets[i].size());
+            }
+            socketSendBatch(fd, acks);
+        }
+        if (!acked.empty()) {
+            std::lock_guard<std::mutex> lock(syncMutex);
+            for (const auto &it : acked) {
+                syncSender->ack(it);
+            }
+            syncTrigger.notify_one();
+        }
+        if ((merge.senders.empty()) && (lsas.empty()) && (requests.empty())) {
+            receiverStats.timers[TIMER_RECEIVE].record(watch.elapsed());
+            continue;
+        }
+        merge.sort();
+
+        Stopwatch merging;
         mutex.lock();
-        host->updateForwardingTable(nextHop, routeTable);
+        Stopwatch held;
+        auto changes = host->changes;
+        host->mergeAdvertisements(merge);
+        for (auto i : lsas) {
+            host->receiveLsa(batch.data(i), batch.size(i));
+        }
+        if (host->publish()) {
+            published(*host);
+            receiverStats.counters[COUNT_PUBLISHED].add();
+        }
+        // answered from the snapshot just published, so they include what this batch merged
+        answers.clear();
+        for (auto i : requests) {
+            auto neighbor = std::string(batch.data(i) + 2, batch.size(i) - 2);
+            if (reliable) {
+                host->answer(neighbor, answers, syncSegmentSize(host->name));
+            } else {
+                host->answer(neighbor, host->outbox);
+            }
+        }
+        // flood what the LSAs made us forward or originate, and answer requests, right away
+        if (!host->outbox.neighbors.empty()) {
+            answering = true;
+            trigger.notify_one();
+        }
+        changes = host->changes - changes;
+        receiverStats.timers[TIMER_LOCK].record(held.elapsed());
         mutex.unlock();
+        if (!answers.neighbors.empty()) {
+            std::lock_guard<std::mutex> lock(syncMutex);
+            syncSender->start(answers);
+            syncTrigger.notify_one();
+        }
+        receiverStats.changes.record(changes);
+        receiverStats.counters[COUNT_ROUTE_CHANGES].add(changes);
+        receiverStats.timers[TIMER_MERGE].record(merging.elapsed());
+        receiverStats.timers[TIMER_RECEIVE].record(watch.elapsed());
+    }
+}
+
+// push reliable transfers, sending every datagram when it is due and again until it is acknowledged
+void syncing(int fd, SyncSender *syncSender) {
+    SendBatch batch;
+    auto begin = std::chrono::steady_clock::now();
+    std::unique_lock<std::mutex> lock(syncMutex);
+    for (;;) {
+        std::chrono::duration<double> now = std::chrono::steady_clock::now() - begin;
+        auto retransmitted = syncSender->retransmitted;
+        auto next = syncSender->poll(now.count(), [&](const std::string &, const struct sockaddr_in &addr,
+                const std::string &datagram) {
+            batch.add(addr, datagram.data(), datagram.size());
+            syncStats.counters[COUNT_BYTES_SENT].add(datagram.size());
+        });
+        syncStats.counters[COUNT_SENT].add(batch.size());
+        syncStats.counters[COUNT_SYNC_RETRANSMITS].add(syncSender->retransmitted - retransmitted);
+        // the datagrams belong to syncSender, so they are sent before acknowledgements may free them
+        if (batch.size() > 0) {
+            socketSendBatch(fd, batch);
+        }
+        if (next < 0) {
+            syncTrigger.wait(lock);
+        } else {
+            syncTrigger.wait_until(lock, begin + std::chrono::duration_cast<std::chrono::steady_clock::duration>(
+                std::chrono::duration<double>(next)));
+        }
     }
 }
 
+// answer one command per connection on the stats endpoint: "stats" or "table"
+void serving(int fd, MobileHost *host, Forwarder *forwarder) {
+    for (;;) {
+        auto conn = accept(fd, NULL, NULL);
+        if (conn < 0) {
+            continue;
+        }
+        // a client that sends nothing cannot hold the endpoint, which answers one connection at a time
+        struct timeval timeout = {0, STATS_TIMEOUT_MS * 1000};
+        setsockopt(conn, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+        setsockopt(conn, SOL_SOCKET, SO_SNDTIMEO, &timeout, sizeof(timeout));
+
+        char buf[64];
+        auto len = read(conn, buf, sizeof(buf) - 1);
+        std::string command(buf, (len > 0) ? len : 0);
+        command.erase(command.find_last_not_of(" \r\n") + 1);
+
+        std::ostringstream out;
+        if (command == "table") {
+            host->printOut(out);
+            forwarder->printOut(out);
+        } else if ((command == "stats") || (command.empty())) {
+            writeStats(out, {&senderStats, &receiverStats, &watcherStats, &livenessStats, &syncStats});
+            auto snapshot = host->snapshot();
+            size_t reachable = 0;
+            for (const auto &it : snapshot->forwardingTable) {
+                reachable += (it.second.metric < MAX);
+            }
+            out << "# TYPE dsdv_routes gauge\ndsdv_routes " << reachable << '\n';
+            out << "# TYPE dsdv_table_version gauge\ndsdv_table_version " << snapshot->version << '\n';
+            out << "# TYPE dsdv_data_dropped_total counter\ndsdv_data_dropped_total "
+                << forwarder->dropped.load(std::memory_order_relaxed) << '\n';
+        } else {
+            out << "unknown command, use stats or table\n";
+        }
+        socketWriteAll(conn, out.str());
+        close(conn);
+    }
+}
+
+static void usage(const char *prog) {
+    std::cout << "usage: " << prog << " [-m dv|ls] [-H none|split|poison] [-z] [-k paths] [-b hello_ms] [-c checkpoint] [-C interval] [-S stats_socket] [-F shared_fib] [-t udp|shm] [-R] [-p]"
+        << " <port> <filename>" << std::endl;
+    exit(0);
+}
+
 int main(int argc, char *argv[]) {
-    if (argc != 3) {
-        std::cout << "usage: " << argv[0] << " <port> <filename>" << std::endl;
-        exit(0);
+    int mode = MODE_DV;
+    int horizon = HORIZON_NONE;
+    bool zoning = false;
+    int paths = 1;
+    int transportKind = TRANSPORT_UDP;
+    std::string checkpointFile, statsPath, fibPath;
+    int opt;
+    while ((opt = getopt(argc, argv, "m:H:zk:b:c:C:S:F:t:Rp")) != -1) {
+        switch (opt) {
+        case 'm':
+            mode = parseMode(optarg);
+            if (mode < 0) {
+                usage(argv[0]);
+            }
+            break;
+        case 'H':
+            horizon = parseHorizon(optarg);
+            if (horizon < 0) {
+                usage(argv[0]);
+            }
+            break;
+        case 'z':
+            zoning = true;
+            break;
+        case 'k':
+            paths = atoi(optarg);
+            if ((paths < 1) || (paths > MAX_PATHS)) {
+                usage(argv[0]);
+            }
+            break;
+        case 'b':
+            liveness.interval = atoi(optarg);
+            if (liveness.interval < 0) {
+                usage(argv[0]);
+            }
+            break;
+        case 'c':
+            checkpointFile = optarg;
+            break;
+        case 'C':
+            checkpoint.interval = atoi(optarg);
+            if (checkpoint.interval <= 0) {
+                usage(argv[0]);
+            }
+            break;
+        case 'S':
+            statsPath = optarg;
+            break;
+        case 'F':
+            fibPath = optarg;
+            break;
+        case 't':
+            transportKind = parseTransport(optarg);
+            if (transportKind < 0) {
+                usage(argv[0]);
+            }
+            break;
+        case 'R':
+            reliable = true;
+            break;
+        case 'p':
+            printing = true;
+            break;
+        default:
+            usage(argv[0]);
+        }
+    }
+    if (argc - optind != 2) {
+        usage(argv[0]);
     }
 
-    auto port = atoi(argv[1]);
+    auto port = atoi(argv[optind]);
     if (port <= 0) {
         std::cout << "invalid port number" << std::endl;
         exit(0);
     }
     
-    std::string filename(argv[2]);
-    std::ifstream fin(filename.c_str(), std::ifstream::in);
-    if (!fin.good()) {
-        fin.close();
+    std::string filename(argv[optind + 1]);
+    std::string name;
+    std::map<std::string, class NeighborInfo> neighbors;
+    if (!loadNeighborFile(filename, name, neighbors)) {
         exit(0);
     }
 
-    int lines;
-    std::string name;
-    fin >> lines >> name;
     MobileHost host(name, port);
+    host.horizon = horizon;
+    host.zoning = zoning;
+    host.paths = paths;
+    host.mode = mode;
     host.forwardingTable[name] = ForwardingTableItem(name, 0, 0);
 
-    for (auto i = 0; i < lines; ++i) {
-        std::string neighborName;
-        double neighborMetric;
-        int neighborPort;
-        fin >> neighborName >> neighborMetric >> neighborPort;
-        if (neighborMetric < 0) {
-            neighborMetric = MAX;
+    if (liveness.interval > 0) {
+        liveness.configure(neighbors);
+    }
+    for (auto &it : neighbors) {
+        if (it.second.metric < 0) {
+            it.second.metric = MAX;
+        }
+        host.neighborhood[it.first] = it.second;
+    }
+    // resume from the last checkpoint of this host if there is one, otherwise start from scratch
+    if ((!checkpointFile.empty()) && (!checkpoint.open(checkpointFile))) {
+        exit(0);
+    }
+    // link-state routes are recomputed from the LSDB, which is learned again from the neighbors
+    if ((!checkpointFile.empty()) && (mode == MODE_DV) && (checkpoint.restore(host))) {
+        std::cout << "restored " << host.forwardingTable.size() << " routes from " << checkpointFile << std::endl;
+    }
+    if (fibPath.empty()) {
+        fibPath = fibName(port);
+    }
+    if (!fib.open(fibPath)) {
+        exit(0);
+    }
+    host.publish();
+    published(host);
+    // the first round asks every neighbor for its table instead of waiting for their periods
+    for (const auto &it : host.neighborhood) {
+        if (it.second.metric < MAX) {
+            host.request(it.first);
         }
-        host.neighborhood[neighborName] = NeighborInfo(neighborMetric, neighborPort);
     }
-
-    fin.close();
 
     auto fd = socketBind(port);
+    offload = socketOffload(fd);
     //std::cout << "init fd " << fd << " port " << port << std::endl;
-    std::thread sender(sending, fd, &host, filename);
-    std::thread receiver(receiving, fd, &host);
+    if (statsPath.empty()) {
+        statsPath = "/tmp/dsdv-" + std::to_string(port) + ".sock";
+    }
+    auto statsFd = socketListen(statsPath);
+    if (statsFd < 0) {
+        exit(0);
+    }
+    Forwarder forwarder(&host);
+    Transport transport(fd, port, transportKind);
+    if (!transport.open()) {
+        exit(0);
+    }
+    std::thread sender(sending, fd, &host, &forwarder, &transport);
+    SyncSender syncSender(host.name);
+    std::thread receiver(receiving, fd, &host, &forwarder, &transport, &syncSender);
+    std::thread sync;
+    if (reliable) {
+        sync = std::thread(syncing, fd, &syncSender);
+    }
+    std::thread watcher(watching, &host, filename);
+    std::thread server(serving, statsFd, &host, &forwarder);
+    std::thread beater;
+    if (liveness.interval > 0) {
+        beater = std::thread(beating, fd, &host);
+    }
     sender.join();
     receiver.join();
+    watcher.join();
+    server.join();
+    if (beater.joinable()) {
+        beater.join();
+    }
+    if (sync.joinable()) {
+        sync.join();
+    }
+    close(statsFd);
     close(fd);
 
     return 0;
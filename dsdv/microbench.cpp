@@ -0,0 +1,226 @@
+#include <getopt.h>
+#include <unistd.h>
+#include <chrono>
+#include <cstdlib>
+#include <functional>
+#include <new>
+#include <random>
+#include "dsdv.h"
+
+// every heap allocation of the process is counted, an operation is charged the difference
+static unsigned long allocations = 0;
+
+void *operator new(size_t size) {
+    ++allocations;
+    auto p = malloc(size ? size : 1);
+    if (!p) {
+        throw std::bad_alloc();
+    }
+    return p;
+}
+
+void operator delete(void *p) noexcept {
+    free(p);
+}
+
+// neighbors the synthetic routes are spread over
+const int NEIGHBORS = 8;
+
+static void usage(const char *prog) {
+    std::cout << "usage: " << prog << " [-n routes,...] [-f csv|json] [-t seconds] [-l label]" << std::endl;
+    exit(0);
+}
+
+class Result {
+public:
+    std::string op;
+    long routes;
+    long iterations;
+    double nsPerOp;
+    double allocsPerOp;
+    // produced by serializers, consumed by parsers and merges, per operation
+    size_t bytes;
+};
+
+// run op until budget seconds passed, at least once; op returns the bytes it produced or consumed
+static Result measure(const std::string &name, long routes, double budget, const std::function<size_t()> &op) {
+    Result ret;
+    ret.op = name;
+    ret.routes = routes;
+    ret.iterations = 0;
+    ret.bytes = 0;
+    auto before = allocations;
+    auto begin = std::chrono::steady_clock::now();
+    std::chrono::duration<double> elapsed;
+    do {
+        ret.bytes = op();
+        ++ret.iterations;
+        elapsed = std::chrono::steady_clock::now() - begin;
+    } while (elapsed.count() < budget);
+    ret.nsPerOp = elapsed.count() * 1e9 / ret.iterations;
+    ret.allocsPerOp = static_cast<double>(allocations - before) / ret.iterations;
+    return ret;
+}
+
+// a host with routes to n destinations through NEIGHBORS neighbors, and the advertisement of one of them
+static void build(MobileHost &host, MobileHost &peer, long n, std::mt19937 &rng) {
+    std::uniform_int_distribution<int> metric(1, 100);
+    for (auto i = 0; i < NEIGHBORS; ++i) {
+        auto neighbor = "n" + std::to_string(i);
+        host.neighborhood[neighbor] = NeighborInfo(metric(rng), 3000 + i);
+        peer.neighborhood[neighbor] = NeighborInfo(metric(rng), 3000 + i);
+    }
+    host.forwardingTable[host.name] = ForwardingTableItem(host.name, 0, 0);
+    peer.forwardingTable[peer.name] = ForwardingTableItem(peer.name, 0, 0);
+    for (long i = 0; i < n; ++i) {
+        auto destination = "d" + std::to_string(i);
+        auto seqNum = 2 * (i % 50);
+        host.forwardingTable[destination] = ForwardingTableItem("n" + std::to_string(i % NEIGHBORS), metric(rng), seqNum);
+        // the neighbor knows the same sequence numbers with longer routes, so merging it changes nothing
+        peer.forwardingTable[destination] = ForwardingTableItem("n1", 200 + metric(rng), seqNum);
+    }
+    host.publish();
+    peer.publish();
+}
+
+// a neighbor file of n links, the name of the file is returned
+static std::string neighborFile(long n) {
+    auto filename = "/tmp/dsdv_micro_" + std::to_string(getpid()) + ".dat";
+    std::ofstream fout(filename.c_str());
+    fout << n << " h\n";
+    for (long i = 0; i < n; ++i) {
+        fout << "n" << i << ' ' << (1 + i % 100) << ' ' << (3000 + i % 60000) << '\n';
+    }
+    return filename;
+}
+
+static void run(long n, double budget, std::vector<Result> &results) {
+    std::mt19937 rng(n);
+    MobileHost host("h", 3031), peer("n0", 3000);
+    build(host, peer, n, rng);
+
+    std::string str;
+    results.push_back(measure("serialize", n, budget, [&]() {
+        str = host.serialize();
+        return str.size();
+    }));
+
+    Advertisements ads;
+    results.push_back(measure("advertise", n, budget, [&]() {
+        host.advertise(ads);
+        size_t bytes = 0;
+        for (const auto &it : ads.packets) {
+            bytes += it.size();
+        }
+        return bytes;
+    }));
+
+    auto advertisement = peer.serialize();
+    std::string nextHop;
+    std::map<std::string, class RouteTableItem> routeTable;
+    results.push_back(measure("deserialize", n, budget, [&]() {
+        routeTable = host.deserialize(advertisement, nextHop);
+        return advertisement.size();
+    }));
+
+    results.push_back(measure("updateForwardingTable", n, budget, [&]() {
+        host.updateForwardingTable(nextHop, routeTable);
+        return advertisement.size();
+    }));
+    routeTable.clear();
+
+    results.push_back(measure("mergeAdvertisement", n, budget, [&]() {
+        host.mergeAdvertisement(advertisement.data(), advertisement.size());
+        return advertisement.size();
+    }));
+
+    // the path of the receiver: segments parsed into one batch, sorted, merged
+    Advertisements peerAds;
+    peer.advertise(peerAds);
+    const auto &packet = peerAds.packets.front();
+    MergeBatch batch;
+    results.push_back(measure("mergeAdvertisements", n, budget, [&]() {
+        batch.clear();
+        for (size_t offset = 0; offset < packet.size(); offset += SEGMENT_SIZE) {
+            batch.parse(packet.data() + offset, std::min(packet.size() - offset, static_cast<size_t>(SEGMENT_SIZE)));
+        }
+        batch.sort();
+        host.mergeAdvertisements(batch);
+        return packet.size();
+    }));
+
+    // the first refresh adds every link, the measured ones find nothing changed
+    auto filename = neighborFile(n);
+    MobileHost watcher("h", 3031);
+    watcher.refreshNeighborInfo(filename);
+    // the table requests to every new neighbor are never sent
+    watcher.outbox.clear();
+    std::ifstream fin(filename.c_str(), std::ifstream::ate);
+    size_t fileSize = fin.tellg();
+    results.push_back(measure("refreshNeighborInfo", n, budget, [&]() {
+        watcher.refreshNeighborInfo(filename);
+        return fileSize;
+    }));
+    unlink(filename.c_str());
+}
+
+int main(int argc, char *argv[]) {
+    std::vector<long> sizes = {10, 1000, 100000, 1000000};
+    std::string format = "csv", label;
+    double budget = 0.2;
+
+    std::string arg;
+    int opt;
+    while ((opt = getopt(argc, argv, "n:f:t:l:")) != -1) {
+        switch (opt) {
+        case 'n':
+            sizes.clear();
+            for (std::istringstream sin(optarg); std::getline(sin, arg, ','); ) {
+                sizes.push_back(atol(arg.c_str()));
+                if (sizes.back() <= 0) {
+                    usage(argv[0]);
+                }
+            }
+            break;
+        case 'f': format = optarg; break;
+        case 't': budget = atof(optarg); break;
+        case 'l': label = optarg; break;
+        default: usage(argv[0]);
+        }
+    }
+    if ((optind != argc) || ((format != "csv") && (format != "json"))) {
+        usage(argv[0]);
+    }
+
+    // one line per operation and size, so runs of different commits can be diffed or joined
+    if (format == "csv") {
+        std::cout << "label,op,routes,iterations,ns_per_op,ns_per_route,allocs_per_op,bytes" << std::endl;
+    } else {
+        std::cout << "[" << std::endl;
+    }
+    bool first = true;
+    for (auto n : sizes) {
+        std::vector<Result> results;
+        run(n, budget, results);
+        for (const auto &it : results) {
+            if (format == "csv") {
+                std::cout << label << ',' << it.op << ',' << it.routes << ',' << it.iterations << ','
+                    << setiosflags(std::ios::fixed) << std::setprecision(1) << it.nsPerOp << ','
+                    << std::setprecision(2) << (it.nsPerOp / it.routes) << ',' << it.allocsPerOp << ','
+                    << it.bytes << std::endl;
+            } else {
+                std::cout << (first ? "  " : ", ") << "{\"label\": \"" << label << "\", \"op\": \"" << it.op
+                    << "\", \"routes\": " << it.routes << ", \"iterations\": " << it.iterations
+                    << setiosflags(std::ios::fixed) << std::setprecision(1) << ", \"ns_per_op\": " << it.nsPerOp
+                    << std::setprecision(2) << ", \"ns_per_route\": " << (it.nsPerOp / it.routes)
+                    << ", \"allocs_per_op\": " << it.allocsPerOp << ", \"bytes\": " << it.bytes << "}" << std::endl;
+            }
+            first = false;
+        }
+    }
+    if (format == "json") {
+        std::cout << "]" << std::endl;
+    }
+
+    return 0;
+}
@@ -0,0 +1,138 @@
+#include <sys/mman.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <cstring>
+#include <algorithm>
+#include "publisher.h"
+
+static const char MAGIC[8] = {'D', 'S', 'D', 'V', 'F', 'I', 'B', '1'};
+
+FibPublisher::~FibPublisher() {
+    if (base) {
+        munmap(base, length);
+    }
+    if (fd >= 0) {
+        close(fd);
+        shm_unlink(name.c_str());
+    }
+}
+
+bool FibPublisher::open(const std::string &n) {
+    // readers of a previous host keep their object, new ones find the fresh one
+    shm_unlink(n.c_str());
+    fd = shm_open(n.c_str(), O_RDWR | O_CREAT | O_EXCL | O_CLOEXEC, 0644);
+    if (fd < 0) {
+        std::cerr << "open shared fib error" << std::endl;
+        return false;
+    }
+    name = n;
+    if (!reserve(sizeof(FibHeader))) {
+        return false;
+    }
+
+    auto h = header();
+    memcpy(h->magic, MAGIC, sizeof(MAGIC));
+    h->size.store(length);
+    places[0] = places[1] = std::make_pair(static_cast<uint64_t>(0), static_cast<uint64_t>(0));
+    return true;
+}
+
+void FibPublisher::save(const MobileHost &host) {
+    auto snapshot = host.snapshot();
+    if ((fd < 0) || (snapshot->version == version)) {
+        return;
+    }
+    version = snapshot->version;
+
+    // lay out the keys first to know the size of the table
+    const auto &table = snapshot->forwardingTable;
+    keys.clear();
+    uint32_t routes = 0;
+    for (const auto &it : table) {
+        if (it.second.nextHop.size() < static_cast<size_t>(FIB_NAME)) {
+            keys.insert(keys.end(), it.first.begin(), it.first.end());
+            ++routes;
+        }
+    }
+    uint32_t slots = 16;
+    while (slots < 2 * routes) {
+        slots *= 2;
+    }
+    uint64_t size = sizeof(FibTable) + slots * sizeof(FibRecord) + keys.size();
+
+    auto h = header();
+    auto target = 1 - h->active.load(std::memory_order_relaxed);
+    if (places[target].second < size) {
+        // both tables move to the end of the object, twice as large as needed; the old space is
+        // left behind, readers still in it are told to retry by the seqlock
+        auto capacity = 2 * size;
+        auto end = h->size.load(std::memory_order_relaxed);
+        if (!reserve(end + 2 * capacity)) {
+            return;
+        }
+        h = header();
+        places[target] = std::make_pair(end, capacity);
+        places[1 - target] = std::make_pair(end + capacity, capacity);
+        h->size.store(length, std::memory_order_release);
+    }
+
+    auto &buffer = h->buffers[target];
+    auto seq = buffer.seq.load(std::memory_order_relaxed);
+    buffer.seq.store(seq + 1, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+
+    buffer.offset = places[target].first;
+    buffer.length = size;
+    auto t = reinterpret_cast<FibTable *>(base + buffer.offset);
+    t->slots = slots;
+    t->routes = routes;
+    t->keys = keys.size();
+    auto records = reinterpret_cast<FibRecord *>(t + 1);
+    memset(records, 0, slots * sizeof(FibRecord));
+    memcpy(reinterpret_cast<char *>(records + slots), keys.data(), keys.size());
+    uint32_t offset = 0;
+    for (const auto &it : table) {
+        if (it.second.nextHop.size() >= static_cast<size_t>(FIB_NAME)) {
+            continue;
+        }
+        auto hash = fibHash(it.first.data(), it.first.size());
+        auto slot = hash & (slots - 1);
+        while (records[slot].length != 0) {
+            slot = (slot + 1) & (slots - 1);
+        }
+        auto &record = records[slot];
+        record.hash = hash;
+        record.offset = offset;
+        record.length = it.first.size();
+        memcpy(record.nextHop, it.second.nextHop.c_str(), it.second.nextHop.size() + 1);
+        record.metric = it.second.metric;
+        record.seqNum = it.second.seqNum;
+        offset += it.first.size();
+    }
+
+    buffer.seq.store(seq + 2, std::memory_order_release);
+    h->active.store(target, std::memory_order_release);
+    h->generation.fetch_add(1, std::memory_order_release);
+}
+
+// grow the object and the mapping to at least size bytes
+bool FibPublisher::reserve(size_t size) {
+    if (size <= length) {
+        return true;
+    }
+    if (ftruncate(fd, size) < 0) {
+        std::cerr << "grow shared fib error" << std::endl;
+        return false;
+    }
+    auto next = static_cast<char *>(mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0));
+    if (next == MAP_FAILED) {
+        std::cerr << "map shared fib error" << std::endl;
+        return false;
+    }
+    if (base) {
+        munmap(base, length);
+    }
+    base = next;
+    length = size;
+    return true;
+}
@@ -0,0 +1,36 @@
+#ifndef PUBLISHER_H_
+#define PUBLISHER_H_
+
+#include "dsdv.h"
+#include "fibclient.h"
+
+// writes every published table version of a host into shared memory for FibClient readers:
+// two tables, readers use the active one while the other is rewritten, so the writer never
+// waits for readers and readers never block the writer
+class FibPublisher {
+public:
+    FibPublisher() : fd(-1), base(nullptr), length(0), version(0) {}
+    ~FibPublisher();
+
+    // create the shared memory object name, replacing a stale one
+    bool open(const std::string &name);
+
+    // publish the current snapshot of host if it is a newer version than the last one
+    void save(const MobileHost &host);
+
+private:
+    int fd;
+    char *base;
+    size_t length;
+    unsigned long version;
+    std::string name;
+    // where each table is written next, which may differ from the header until it is
+    std::pair<uint64_t, uint64_t> places[2];
+    // reused to lay out a table
+    std::vector<char> keys;
+
+    FibHeader *header() { return reinterpret_cast<FibHeader *>(base); }
+    bool reserve(size_t size);
+};
+
+#endif
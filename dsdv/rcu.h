@@ -0,0 +1,78 @@
+#ifndef RCU_H_
+#define RCU_H_
+
+#include <atomic>
+#include <thread>
+
+// pointer to an immutable object, replaced by a single writer with read-copy-update:
+// readers never block or take a lock, the writer swaps in the next version and waits
+// until no reader can still see the previous one before freeing it
+template <class T>
+class RcuPointer {
+public:
+    // keeps the version it was created with alive until destroyed
+    class ReadGuard {
+    public:
+        ReadGuard(const RcuPointer *p, int s) : parent(p), slot(s), ptr(p->ptr.load()) {}
+        ReadGuard(ReadGuard &&g) : parent(g.parent), slot(g.slot), ptr(g.ptr) { g.parent = nullptr; }
+        ~ReadGuard() {
+            if (parent) {
+                --parent->readers[slot];
+            }
+        }
+
+        const T *get() const { return ptr; }
+        const T *operator->() const { return ptr; }
+        const T &operator*() const { return *ptr; }
+
+    private:
+        const RcuPointer *parent;
+        int slot;
+        const T *ptr;
+
+        ReadGuard(const ReadGuard &) = delete;
+        ReadGuard &operator=(const ReadGuard &) = delete;
+    };
+
+    RcuPointer() : ptr(nullptr), epoch(0) {
+        readers[0] = 0;
+        readers[1] = 0;
+    }
+
+    ~RcuPointer() {
+        delete ptr.load();
+    }
+
+    ReadGuard read() const {
+        for (;;) {
+            // register in the current epoch, retry if the writer moved on meanwhile
+            auto e = epoch.load();
+            ++readers[e & 1];
+            if (epoch.load() == e) {
+                return ReadGuard(this, e & 1);
+            }
+            --readers[e & 1];
+        }
+    }
+
+    // only one writer at a time, next is owned by this pointer afterwards
+    void publish(T *next) {
+        auto prev = ptr.exchange(next);
+        // readers registered from now on can only see next
+        auto e = epoch.fetch_add(1);
+        while (readers[e & 1].load() != 0) {
+            std::this_thread::yield();
+        }
+        delete prev;
+    }
+
+private:
+    std::atomic<T *> ptr;
+    mutable std::atomic<unsigned long> epoch;
+    mutable std::atomic<int> readers[2];
+
+    RcuPointer(const RcuPointer &) = delete;
+    RcuPointer &operator=(const RcuPointer &) = delete;
+};
+
+#endif
@@ -0,0 +1,50 @@
+#include <chrono>
+#include "forwarder.h"
+
+// inject data datagrams into the dsdv host bound to port, to be relayed to destination
+int main(int argc, char *argv[]) {
+    if ((argc < 3) || (argc > 6)) {
+        std::cout << "usage: " << argv[0] << " <port> <destination> [count] [size] [flows]" << std::endl;
+        exit(0);
+    }
+
+    auto port = atoi(argv[1]);
+    std::string destination(argv[2]);
+    long count = (argc > 3) ? atol(argv[3]) : 1;
+    size_t size = (argc > 4) ? atoi(argv[4]) : 64;
+    auto flows = (argc > 5) ? atoi(argv[5]) : 1;
+    if ((port <= 0) || (count <= 0) || (flows <= 0) || (destination.size() > 255)) {
+        std::cout << "invalid arguments" << std::endl;
+        exit(0);
+    }
+
+    auto fd = socket(AF_INET, SOCK_DGRAM, 0);
+    if (fd < 0) {
+        std::cerr << "create socket error" << std::endl;
+        exit(0);
+    }
+    auto addr = socketAddress(port);
+
+    // one prebuilt datagram per flow, at least large enough for the header
+    std::vector<std::vector<char> > packets(flows);
+    for (auto i = 0; i < flows; ++i) {
+        packets[i].resize(std::max<size_t>(size, DATA_HEADER + destination.size()), 'x');
+        dataHeader(packets[i].data(), destination, i);
+    }
+
+    SendBatch batch;
+    auto begin = std::chrono::steady_clock::now();
+    for (long sent = 0; sent < count; ) {
+        for (auto i = 0; (i < BATCH) && (sent < count); ++i, ++sent) {
+            const auto &packet = packets[sent % flows];
+            batch.add(addr, packet.data(), packet.size());
+        }
+        socketSendBatch(fd, batch);
+    }
+    std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - begin;
+
+    std::cout << "sent " << count << " packets of " << packets[0].size() << " bytes in " << elapsed.count()
+        << "s, " << static_cast<long>(count / elapsed.count()) << " packets/s" << std::endl;
+    close(fd);
+    return 0;
+}
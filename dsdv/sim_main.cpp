@@ -0,0 +1,88 @@
+#include <getopt.h>
+#include "simulator.h"
+
+static void usage(const char *prog) {
+    std::cout << "usage: " << prog << " [-P period] [-l latency] [-j jitter] [-p loss_rate] [-q quiet] [-T max_time]"
+        << " [-s script] [-m dv|ls] [-R] [-H none|split|poison] [-z] [-k paths] [-r seed] [-v] <filename>..." << std::endl;
+    exit(0);
+}
+
+int main(int argc, char *argv[]) {
+    double period = 5, latency = 0.01, jitter = 0, lossRate = 0, quiet = -1, maxTime = 3600;
+    unsigned seed = 1;
+    int mode = MODE_DV, horizon = HORIZON_NONE, paths = 1;
+    std::string script;
+    bool zoning = false, verbose = false, reliable = false;
+
+    int opt;
+    while ((opt = getopt(argc, argv, "P:l:j:p:q:T:s:m:RH:zk:r:v")) != -1) {
+        switch (opt) {
+        case 'P': period = atof(optarg); break;
+        case 'l': latency = atof(optarg); break;
+        case 'j': jitter = atof(optarg); break;
+        case 'p': lossRate = atof(optarg); break;
+        case 'q': quiet = atof(optarg); break;
+        case 'T': maxTime = atof(optarg); break;
+        case 's': script = optarg; break;
+        case 'm': mode = parseMode(optarg); break;
+        case 'R': reliable = true; break;
+        case 'H': horizon = parseHorizon(optarg); break;
+        case 'z': zoning = true; break;
+        case 'k': paths = atoi(optarg); break;
+        case 'r': seed = atoi(optarg); break;
+        case 'v': verbose = true; break;
+        default: usage(argv[0]);
+        }
+    }
+    if ((optind >= argc) || (period <= 0) || (latency < 0) || (jitter < 0) || (lossRate < 0) || (lossRate > 1) ||
+            (mode < 0) || (horizon < 0) || (paths < 1) || (paths > MAX_PATHS)) {
+        usage(argv[0]);
+    }
+
+    Simulator sim(seed);
+    sim.period = period;
+    sim.latency = latency;
+    sim.jitter = jitter;
+    sim.lossRate = lossRate;
+    // by default three silent periods make a fixed point
+    sim.quiet = (quiet < 0) ? (3 * period) : quiet;
+    sim.maxTime = maxTime;
+    sim.horizon = horizon;
+    sim.zoning = zoning;
+    sim.paths = paths;
+    sim.mode = mode;
+    sim.reliable = reliable;
+    for (auto i = optind; i < argc; ++i) {
+        if (!sim.addHost(argv[i])) {
+            std::cout << "cannot read " << argv[i] << std::endl;
+            exit(0);
+        }
+    }
+    if ((!script.empty()) && (!sim.loadScript(script))) {
+        std::cout << "cannot read " << script << std::endl;
+        exit(0);
+    }
+
+    auto converged = sim.run();
+
+    std::cout << "## " << sim.hosts.size() << " hosts, " << sim.linkEvents.size() << " link events, "
+        << (converged ? "converged" : "NOT converged") << std::endl;
+    for (size_t i = 0; i < sim.epochs.size(); ++i) {
+        const auto &it = sim.epochs[i];
+        std::cout << "epoch " << i << " at " << setiosflags(std::ios::fixed) << std::setprecision(3) << it.start
+            << "s: converged in " << (it.lastChange - it.start) << "s, " << it.messages << " messages, "
+            << it.bytes << " bytes, " << it.lost << " lost" << std::endl;
+    }
+    std::cout << "total: " << sim.totalMessages() << " messages, " << sim.totalBytes() << " bytes, "
+        << std::setprecision(2) << sim.cpuTime << " ms CPU" << std::endl;
+
+    if (verbose) {
+        for (const auto &it : sim.hosts) {
+            // hosts publish only when they broadcast, the last changes may not be visible yet
+            it->publish();
+            it->printOut();
+        }
+    }
+
+    return 0;
+}
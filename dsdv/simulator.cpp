@@ -0,0 +1,288 @@
+#include "simulator.h"
+
+Simulator::Simulator(unsigned seed) : period(5), latency(0.01), jitter(0), lossRate(0), quiet(15), maxTime(3600),
+        horizon(HORIZON_NONE), zoning(false), paths(1), mode(MODE_DV), reliable(false),
+        cpuTime(0), rng(seed), order(0), now(0) {}
+
+void Simulator::addHost(const std::string &name, int port, const std::map<std::string, class NeighborInfo> &neighbors) {
+    index[name] = hosts.size();
+    hosts.push_back(std::unique_ptr<MobileHost>(new MobileHost(name, port)));
+    syncSenders.push_back(std::unique_ptr<SyncSender>(new SyncSender(name)));
+    syncReceivers.push_back(std::unique_ptr<SyncReceiver>(new SyncReceiver(name)));
+    auto &host = *hosts.back();
+    host.horizon = horizon;
+    host.zoning = zoning;
+    host.paths = paths;
+    host.mode = mode;
+    host.forwardingTable[name] = ForwardingTableItem(name, 0, 0);
+    for (const auto &it : neighbors) {
+        auto metric = (it.second.metric < 0) ? MAX : it.second.metric;
+        host.neighborhood[it.first] = NeighborInfo(metric, it.second.port);
+    }
+}
+
+bool Simulator::addHost(const std::string &filename) {
+    std::string name;
+    std::map<std::string, class NeighborInfo> neighbors;
+    if (!loadNeighborFile(filename, name, neighbors)) {
+        return false;
+    }
+
+    // the port of a host is only known to its neighbors and never used in-process
+    addHost(name, 0, neighbors);
+    return true;
+}
+
+bool Simulator::loadScript(const std::string &filename) {
+    std::ifstream fin(filename.c_str(), std::ifstream::in);
+    if (!fin.good()) {
+        fin.close();
+        return false;
+    }
+
+    std::string line;
+    while (std::getline(fin, line)) {
+        std::istringstream sin(line);
+        LinkEvent e;
+        if ((line.empty()) || (line[0] == '#')) {
+            continue;
+        }
+        if (!(sin >> e.time >> e.a >> e.b >> e.metric)) {
+            std::cerr << "invalid link event: " << line << std::endl;
+            fin.close();
+            return false;
+        }
+        linkEvents.push_back(e);
+    }
+
+    fin.close();
+    return true;
+}
+
+bool Simulator::run() {
+    auto begin = std::clock();
+    bool converged = false;
+
+    now = 0;
+    epochs.clear();
+    epochs.push_back(EpochStats(0));
+    // hosts are started at random moments during the first period
+    for (size_t i = 0; i < hosts.size(); ++i) {
+        schedule(SimEvent(random() * period, 0, SIM_BROADCAST, i));
+    }
+    for (size_t i = 0; i < linkEvents.size(); ++i) {
+        schedule(SimEvent(linkEvents[i].time, 0, SIM_LINK, i));
+    }
+
+    auto pendingLinks = linkEvents.size();
+    while (!events.empty()) {
+        auto e = std::move(const_cast<SimEvent &>(events.top()));
+        events.pop();
+        now = e.time;
+        if ((pendingLinks == 0) && (now - epochs.back().lastChange > quiet)) {
+            converged = true;
+            break;
+        }
+        if (now > maxTime) {
+            break;
+        }
+
+        switch (e.type) {
+        case SIM_BROADCAST:
+            broadcast(e.target, e.ticks);
+            break;
+        case SIM_DELIVER:
+            deliver(e.target, e.payload);
+            break;
+        case SIM_LINK:
+            --pendingLinks;
+            changeLink(linkEvents[e.target]);
+            break;
+        case SIM_SYNC:
+            sync(e.target);
+            break;
+        }
+    }
+
+    cpuTime = (std::clock() - begin) * 1000.0 / CLOCKS_PER_SEC;
+    return converged;
+}
+
+long Simulator::totalMessages() const {
+    long ret = 0;
+    for (const auto &it : epochs) {
+        ret += it.messages;
+    }
+    return ret;
+}
+
+long Simulator::totalBytes() const {
+    long ret = 0;
+    for (const auto &it : epochs) {
+        ret += it.bytes;
+    }
+    return ret;
+}
+
+void Simulator::schedule(class SimEvent e) {
+    e.order = order++;
+    events.push(std::move(e));
+}
+
+// same as one iteration of sending() in main.cpp, without re-reading the neighbor file
+void Simulator::broadcast(int host, int ticks) {
+    auto &sender = *hosts[host];
+    sender.seqNum += 2;
+    // a single thread, so changes are published only when they are about to be read
+    sender.publish();
+    if (ticks == 0) {
+        // a host that starts asks its neighbors for their tables, as main() does
+        for (const auto &it : sender.neighborhood) {
+            if (it.second.metric < MAX) {
+                sender.request(it.first);
+            }
+        }
+    }
+    Advertisements ads;
+    if (sender.mode == MODE_LS) {
+        if (ticks % LSA_REFRESH == 0) {
+            sender.originate();
+        }
+    } else {
+        sender.advertise(ads);
+        send(ads);
+    }
+    flush(host);
+
+    SimEvent e(now + period, 0, SIM_BROADCAST, host);
+    e.ticks = ticks + 1;
+    schedule(std::move(e));
+}
+
+void Simulator::send(const class Advertisements &ads) {
+    for (const auto &it : ads.neighbors) {
+        // every segment is a datagram of its own, lost or delivered independently
+        const auto &packet = ads.packets[it.second];
+        for (size_t offset = 0; offset < packet.size(); offset += SEGMENT_SIZE) {
+            transmit(it.first, packet.substr(offset, SEGMENT_SIZE));
+        }
+    }
+}
+
+void Simulator::transmit(const std::string &neighbor, const std::string &datagram) {
+    auto it = index.find(neighbor);
+    if (it == index.end()) {
+        return;
+    }
+    ++epochs.back().messages;
+    epochs.back().bytes += datagram.size();
+    if (random() < lossRate) {
+        ++epochs.back().lost;
+        return;
+    }
+    SimEvent e(now + latency + jitter * random(), 0, SIM_DELIVER, it->second);
+    e.payload = datagram;
+    schedule(std::move(e));
+}
+
+void Simulator::sync(int host) {
+    auto next = syncSenders[host]->poll(now, [this](const std::string &neighbor, const struct sockaddr_in &,
+            const std::string &datagram) {
+        transmit(neighbor, datagram);
+    });
+    // a wakeup that finds nothing due schedules the next one again, spurious ones are harmless
+    if (next >= 0) {
+        schedule(SimEvent(next, 0, SIM_SYNC, host));
+    }
+}
+
+// same as one iteration of receiving() in main.cpp
+void Simulator::deliver(int host, const std::string &payload) {
+    auto &receiver = *hosts[host];
+    if ((payload.size() > 2) && (payload[0] == PKT_REQUEST)) {
+        // answered at once from an up to date snapshot
+        receiver.publish();
+        if (reliable) {
+            Advertisements answers;
+            receiver.answer(payload.substr(2), answers, syncSegmentSize(receiver.name));
+            syncSenders[host]->start(answers);
+            sync(host);
+        } else {
+            receiver.answer(payload.substr(2), receiver.outbox);
+            flush(host);
+        }
+        return;
+    }
+    SyncHeader header;
+    size_t offset;
+    if ((!payload.empty()) && (payload[0] == PKT_SYNC_ACK)) {
+        if ((parseSync(payload.data(), payload.size(), header, offset)) && (syncSenders[host]->ack(header))) {
+            // the window may have moved
+            sync(host);
+        }
+        return;
+    }
+    if ((!payload.empty()) && (payload[0] == PKT_SYNC_DATA)) {
+        std::string ack;
+        if (!parseSync(payload.data(), payload.size(), header, offset)) {
+            return;
+        }
+        auto fresh = syncReceivers[host]->receive(header, ack);
+        transmit(header.sender, ack);
+        if (fresh) {
+            deliver(host, payload.substr(offset));
+        }
+        return;
+    }
+    if ((!payload.empty()) && (payload[0] == PKT_LSA)) {
+        // flooding does not wait for the next period, like the triggered sender in main.cpp
+        if (receiver.receiveLsa(payload.data(), payload.size())) {
+            epochs.back().lastChange = now;
+        }
+        flush(host);
+        return;
+    }
+    merge.clear();
+    merge.parse(payload.data(), payload.size());
+    merge.sort();
+    if (receiver.mergeAdvertisements(merge)) {
+        epochs.back().lastChange = now;
+    }
+}
+
+void Simulator::changeLink(const class LinkEvent &e) {
+    epochs.push_back(EpochStats(now));
+    const std::string *ends[2][2] = {{&e.a, &e.b}, {&e.b, &e.a}};
+    for (auto &end : ends) {
+        auto it = index.find(*end[0]);
+        if (it == index.end()) {
+            std::cerr << "unknown host " << *end[0] << " in link event" << std::endl;
+            continue;
+        }
+        auto &host = *hosts[it->second];
+        auto neighbor = host.neighborhood.find(*end[1]);
+        auto port = (neighbor == host.neighborhood.end()) ? 0 : neighbor->second.port;
+        if (host.updateNeighbor(*end[1], e.metric, port)) {
+            host.forwardingTable[host.name].seqNum += 2;
+            epochs.back().lastChange = now;
+            if (host.mode == MODE_LS) {
+                host.originate();
+            }
+            // LSAs, and the request to a neighbor that came up
+            flush(it->second);
+        }
+    }
+}
+
+void Simulator::flush(int host) {
+    auto &sender = *hosts[host];
+    if (!sender.outbox.neighbors.empty()) {
+        Advertisements ads;
+        std::swap(ads, sender.outbox);
+        send(ads);
+    }
+}
+
+double Simulator::random() {
+    return std::uniform_real_distribution<double>(0, 1)(rng);
+}
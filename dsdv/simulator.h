@@ -0,0 +1,133 @@
+#ifndef SIMULATOR_H_
+#define SIMULATOR_H_
+
+#include <ctime>
+#include <memory>
+#include <queue>
+#include <random>
+#include "dsdv.h"
+#include "sync.h"
+
+// a scripted change of link cost between two hosts, negative metric takes the link down
+class LinkEvent {
+public:
+    double time;
+    std::string a;
+    std::string b;
+    double metric;
+
+    LinkEvent() = default;
+    LinkEvent(double t, std::string x, std::string y, double m) : time(t), a(x), b(y), metric(m) {}
+};
+
+// statistics of one convergence epoch, an epoch starts at time 0 and at every link event
+class EpochStats {
+public:
+    double start;
+    double lastChange;
+    long messages;
+    long bytes;
+    long lost;
+
+    EpochStats() = default;
+    EpochStats(double s) : start(s), lastChange(s), messages(0), bytes(0), lost(0) {}
+};
+
+enum { SIM_BROADCAST = 0, SIM_DELIVER, SIM_LINK, SIM_SYNC };
+
+class SimEvent {
+public:
+    double time;
+    // tie breaker, events scheduled at the same time happen in FIFO order
+    long order;
+    int type;
+    // host index for broadcast/deliver/sync, link event index for link
+    int target;
+    // periods the host already broadcast for, broadcast only
+    int ticks;
+    std::string payload;
+
+    SimEvent() = default;
+    SimEvent(double t, long o, int y, int g) : time(t), order(o), type(y), target(g), ticks(0) {}
+
+    bool operator>(const SimEvent &e) const {
+        return (time > e.time) || ((time == e.time) && (order > e.order));
+    }
+};
+
+// in-process virtual-time network of mobile hosts
+class Simulator {
+public:
+    // broadcast period of every host (in seconds)
+    double period;
+    // one-way latency of every link and its uniform random jitter (in seconds)
+    double latency;
+    double jitter;
+    // probability that an advertisement is lost on the link
+    double lossRate;
+    // the network is converged when no route changes for this long
+    double quiet;
+    // the simulation stops at this time even if not converged
+    double maxTime;
+    // HORIZON_* of every host
+    int horizon;
+    // zone-based routing on every host
+    bool zoning;
+    // next hops kept per destination on every host
+    int paths;
+    // MODE_* of every host
+    int mode;
+    // answer table requests by reliable transfers on every host
+    bool reliable;
+
+    std::vector<std::unique_ptr<MobileHost> > hosts;
+    std::map<std::string, int> index;
+    std::vector<class LinkEvent> linkEvents;
+    std::vector<class EpochStats> epochs;
+    // CPU time spent in run() (in milliseconds)
+    double cpuTime;
+
+    Simulator(unsigned seed);
+
+    // add a host with its neighbor configuration, metric semantics follow the neighbor file
+    void addHost(const std::string &name, int port, const std::map<std::string, class NeighborInfo> &neighbors);
+
+    // add a host from a neighbor file, return false if the file cannot be read
+    bool addHost(const std::string &filename);
+
+    // load scripted link events, one "<time> <host> <host> <metric>" per line
+    bool loadScript(const std::string &filename);
+
+    // run until the network stays unchanged for `quiet` seconds after the last link event
+    bool run();
+
+    // total messages/bytes over all epochs
+    long totalMessages() const;
+    long totalBytes() const;
+
+private:
+    std::mt19937 rng;
+    std::priority_queue<class SimEvent, std::vector<class SimEvent>, std::greater<class SimEvent> > events;
+    long order;
+    double now;
+    // reused by every delivery
+    class MergeBatch merge;
+    // both halves of reliable transfers of every host
+    std::vector<std::unique_ptr<SyncSender> > syncSenders;
+    std::vector<std::unique_ptr<SyncReceiver> > syncReceivers;
+
+    void schedule(class SimEvent e);
+    void broadcast(int host, int ticks);
+    void deliver(int host, const std::string &payload);
+    void send(const class Advertisements &ads);
+    // one datagram from host to its neighbor, lost or delivered
+    void transmit(const std::string &neighbor, const std::string &datagram);
+    // send the reliable transfer datagrams of host that are due, and wake it up when the next one is
+    void sync(int host);
+    // send the LSAs, requests and answers the host queued meanwhile
+    void flush(int host);
+    void changeLink(const class LinkEvent &e);
+    double random();
+};
+
+#endif
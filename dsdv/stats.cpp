@@ -0,0 +1,66 @@
+#include "stats.h"
+
+static const char *TIMER_NAMES[TIMERS] = {
+    "dsdv_serialize_microseconds",
+    "dsdv_send_microseconds",
+    "dsdv_receive_microseconds",
+    "dsdv_deserialize_microseconds",
+    "dsdv_merge_microseconds",
+    "dsdv_lock_hold_microseconds",
+};
+
+static const char *COUNTER_NAMES[COUNTERS] = {
+    "dsdv_advertisements_sent_total",
+    "dsdv_bytes_sent_total",
+    "dsdv_advertisements_received_total",
+    "dsdv_bytes_received_total",
+    "dsdv_route_changes_total",
+    "dsdv_versions_published_total",
+    "dsdv_neighbor_failures_total",
+    "dsdv_routes_aged_total",
+    "dsdv_sync_retransmits_total",
+};
+
+void Histogram::record(uint64_t value) {
+    auto bits = (value == 0) ? 0 : (64 - __builtin_clzll(value));
+    buckets[(bits < HISTOGRAM_BUCKETS) ? bits : (HISTOGRAM_BUCKETS - 1)].add();
+    count.add();
+    sum.add(value);
+}
+
+static void writeHistogram(std::ostream &out, const char *name, const std::string &thread, const Histogram &h) {
+    // buckets are cumulative, bucket i holds values up to 2^i - 1
+    uint64_t total = 0;
+    for (auto i = 0; i < HISTOGRAM_BUCKETS - 1; ++i) {
+        total += h.buckets[i].get();
+        out << name << "_bucket{thread=\"" << thread << "\",le=\"" << ((1ull << i) - 1) << "\"} " << total << '\n';
+    }
+    out << name << "_bucket{thread=\"" << thread << "\",le=\"+Inf\"} " << h.count.get() << '\n';
+    out << name << "_sum{thread=\"" << thread << "\"} " << h.sum.get() << '\n';
+    out << name << "_count{thread=\"" << thread << "\"} " << h.count.get() << '\n';
+}
+
+void writeStats(std::ostream &out, const std::vector<const ThreadStats *> &threads) {
+    for (auto i = 0; i < TIMERS; ++i) {
+        out << "# TYPE " << TIMER_NAMES[i] << " histogram\n";
+        for (auto t : threads) {
+            if (t->timers[i].count.get() > 0) {
+                writeHistogram(out, TIMER_NAMES[i], t->thread, t->timers[i]);
+            }
+        }
+    }
+
+    out << "# TYPE dsdv_route_changes_per_batch histogram\n";
+    for (auto t : threads) {
+        if (t->changes.count.get() > 0) {
+            writeHistogram(out, "dsdv_route_changes_per_batch", t->thread, t->changes);
+        }
+    }
+
+    for (auto i = 0; i < COUNTERS; ++i) {
+        out << "# TYPE " << COUNTER_NAMES[i] << " counter\n";
+        for (auto t : threads) {
+            out << COUNTER_NAMES[i] << "{thread=\"" << t->thread << "\"} " << t->counters[i].get() << '\n';
+        }
+    }
+}
@@ -0,0 +1,91 @@
+#ifndef STATS_H_
+#define STATS_H_
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <ostream>
+#include <string>
+#include <vector>
+
+// bucket i of a histogram counts values of i bits (0, 1, 2-3, 4-7, ...), the last one everything larger
+const int HISTOGRAM_BUCKETS = 24;
+
+// latency histograms of a thread, in microseconds
+enum {
+    TIMER_SERIALIZE = 0,  // building the advertisements of one period
+    TIMER_SEND,           // sending them
+    TIMER_RECEIVE,        // handling one received batch, without waiting for it
+    TIMER_DESERIALIZE,    // parsing one advertisement
+    TIMER_MERGE,          // merging one batch of advertisements and publishing the result
+    TIMER_LOCK,           // holding the global mutex
+    TIMERS
+};
+
+enum {
+    COUNT_SENT = 0,
+    COUNT_BYTES_SENT,
+    COUNT_RECEIVED,
+    COUNT_BYTES_RECEIVED,
+    COUNT_ROUTE_CHANGES,
+    COUNT_PUBLISHED,
+    COUNT_NEIGHBOR_FAILURES,
+    COUNT_ROUTES_AGED,
+    COUNT_SYNC_RETRANSMITS,
+    COUNTERS
+};
+
+// written by a single thread, read by any
+class Counter {
+public:
+    Counter() : value(0) {}
+
+    void add(uint64_t n = 1) {
+        value.store(value.load(std::memory_order_relaxed) + n, std::memory_order_relaxed);
+    }
+    uint64_t get() const { return value.load(std::memory_order_relaxed); }
+
+private:
+    std::atomic<uint64_t> value;
+};
+
+// log2 histogram, written by a single thread
+class Histogram {
+public:
+    Counter buckets[HISTOGRAM_BUCKETS];
+    Counter count;
+    Counter sum;
+
+    void record(uint64_t value);
+};
+
+// metrics owned by one thread, so recording them never contends
+class ThreadStats {
+public:
+    std::string thread;
+    Histogram timers[TIMERS];
+    // routes whose next hop or cost changed, per merged batch
+    Histogram changes;
+    Counter counters[COUNTERS];
+
+    ThreadStats(const std::string &t) : thread(t) {}
+};
+
+// microseconds elapsed since construction or the last restart()
+class Stopwatch {
+public:
+    Stopwatch() : start(std::chrono::steady_clock::now()) {}
+
+    void restart() { start = std::chrono::steady_clock::now(); }
+    uint64_t elapsed() const {
+        return std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - start).count();
+    }
+
+private:
+    std::chrono::steady_clock::time_point start;
+};
+
+// every thread's metrics in the Prometheus text format, histograms that were never recorded are left out
+void writeStats(std::ostream &out, const std::vector<const ThreadStats *> &threads);
+
+#endif
@@ -0,0 +1,143 @@
+#include <random>
+#include "sync.h"
+
+static void appendHeader(std::string &packet, char type, const std::string &name, uint32_t id, uint16_t seq) {
+    packet.push_back(type);
+    packet.push_back(static_cast<char>(name.size()));
+    packet.append(name);
+    uint32_t nid = htonl(id);
+    uint16_t nseq = htons(seq);
+    packet.append(reinterpret_cast<const char *>(&nid), sizeof(nid));
+    packet.append(reinterpret_cast<const char *>(&nseq), sizeof(nseq));
+}
+
+size_t syncSegmentSize(const std::string &name) {
+    // type, name length, name, transfer id, sequence number and count of a data datagram
+    return SEGMENT_SIZE - (2 + name.size() + sizeof(uint32_t) + 2 * sizeof(uint16_t));
+}
+
+bool parseSync(const char *buf, size_t len, SyncHeader &header, size_t &offset) {
+    if ((len < 2) || ((buf[0] != PKT_SYNC_DATA) && (buf[0] != PKT_SYNC_ACK))) {
+        return false;
+    }
+    size_t nameLength = static_cast<unsigned char>(buf[1]);
+    offset = 2 + nameLength + sizeof(uint32_t) + sizeof(uint16_t) + ((buf[0] == PKT_SYNC_DATA) ? sizeof(uint16_t) : 0);
+    if ((nameLength == 0) || (len < offset)) {
+        return false;
+    }
+    header.sender.assign(buf + 2, nameLength);
+    uint32_t id;
+    uint16_t seq, count = 0;
+    memcpy(&id, buf + 2 + nameLength, sizeof(id));
+    memcpy(&seq, buf + 2 + nameLength + sizeof(id), sizeof(seq));
+    if (buf[0] == PKT_SYNC_DATA) {
+        memcpy(&count, buf + 2 + nameLength + sizeof(id) + sizeof(seq), sizeof(count));
+    }
+    header.id = ntohl(id);
+    header.seq = ntohs(seq);
+    header.count = ntohs(count);
+    return (buf[0] == PKT_SYNC_ACK) || (header.seq < header.count);
+}
+
+SyncSender::SyncSender(const std::string &n) : retransmitted(0), name(n), nextId(std::random_device()()) {}
+
+void SyncSender::start(const class Advertisements &ads) {
+    std::map<std::string, Transfer> started;
+    for (size_t i = 0; i < ads.neighbors.size(); ++i) {
+        auto &transfer = started[ads.neighbors[i].first];
+        transfer.addr = ads.addrs[i];
+        const auto &packet = ads.packets[ads.neighbors[i].second];
+        auto segmentSize = syncSegmentSize(name);
+        for (size_t offset = 0; (offset < packet.size()) || (offset == 0); offset += segmentSize) {
+            transfer.datagrams.push_back(packet.substr(offset, segmentSize));
+        }
+    }
+
+    for (auto &it : started) {
+        auto &transfer = it.second;
+        transfer.id = nextId++;
+        transfer.base = 0;
+        uint16_t count = std::min(transfer.datagrams.size(), static_cast<size_t>(UINT16_MAX));
+        transfer.datagrams.resize(count);
+        uint16_t ncount = htons(count);
+        std::string packet;
+        for (uint16_t seq = 0; seq < count; ++seq) {
+            packet.clear();
+            appendHeader(packet, PKT_SYNC_DATA, name, transfer.id, seq);
+            packet.append(reinterpret_cast<const char *>(&ncount), sizeof(ncount));
+            transfer.datagrams[seq].insert(0, packet);
+        }
+        transfer.due.assign(count, 0);
+        transfer.tries.assign(count, 0);
+        transfer.acked.assign(count, false);
+        transfers[it.first] = std::move(transfer);
+    }
+}
+
+bool SyncSender::ack(const SyncHeader &header) {
+    auto it = transfers.find(header.sender);
+    if ((it == transfers.end()) || (it->second.id != header.id) || (header.seq >= it->second.acked.size()) ||
+            (it->second.acked[header.seq])) {
+        return false;
+    }
+    auto &transfer = it->second;
+    transfer.acked[header.seq] = true;
+    while ((transfer.base < transfer.acked.size()) && (transfer.acked[transfer.base])) {
+        ++transfer.base;
+    }
+    if (transfer.base == transfer.acked.size()) {
+        transfers.erase(it);
+    }
+    return true;
+}
+
+double SyncSender::poll(double now, const std::function<void(const std::string &, const struct sockaddr_in &,
+        const std::string &)> &send) {
+    double next = -1;
+    for (auto it = transfers.begin(); it != transfers.end(); ) {
+        auto &transfer = it->second;
+        bool abandoned = false;
+        auto end = std::min(transfer.base + SYNC_WINDOW, transfer.datagrams.size());
+        for (auto i = transfer.base; i < end; ++i) {
+            if (transfer.acked[i]) {
+                continue;
+            }
+            if (transfer.due[i] <= now) {
+                if (transfer.tries[i] == SYNC_TRIES) {
+                    abandoned = true;
+                    break;
+                }
+                if (transfer.tries[i] > 0) {
+                    ++retransmitted;
+                }
+                ++transfer.tries[i];
+                transfer.due[i] = now + SYNC_TIMEOUT;
+                send(it->first, transfer.addr, transfer.datagrams[i]);
+            }
+            next = ((next < 0) || (transfer.due[i] < next)) ? transfer.due[i] : next;
+        }
+        if (abandoned) {
+            it = transfers.erase(it);
+        } else {
+            ++it;
+        }
+    }
+    return next;
+}
+
+bool SyncReceiver::receive(const SyncHeader &header, std::string &ack) {
+    ack.clear();
+    appendHeader(ack, PKT_SYNC_ACK, name, header.id, header.seq);
+
+    // only the latest transfer of each sender is tracked, it replaced the earlier ones
+    auto &it = received[header.sender];
+    if ((it.second.empty()) || (it.first != header.id)) {
+        it.first = header.id;
+        it.second.assign(header.count, false);
+    }
+    if ((header.seq >= it.second.size()) || (it.second[header.seq])) {
+        return false;
+    }
+    it.second[header.seq] = true;
+    return true;
+}
@@ -0,0 +1,100 @@
+#ifndef SYNC_H_
+#define SYNC_H_
+
+#include <functional>
+#include <map>
+#include <string>
+#include <vector>
+#include "dsdv.h"
+
+// first byte of a datagram of a reliable transfer, and of its acknowledgement; both go on with
+// the length of the sender's name, the name, a 4-byte transfer id and a 2-byte sequence number,
+// a data datagram then with the 2-byte number of datagrams and one datagram of the transfer
+const char PKT_SYNC_DATA = 0x05;
+const char PKT_SYNC_ACK = 0x06;
+
+// datagrams of a transfer in flight at once
+const int SYNC_WINDOW = 32;
+
+// seconds before a datagram that was not acknowledged is sent again
+const double SYNC_TIMEOUT = 0.1;
+
+// a transfer is abandoned after a datagram was sent this many times, the periodic advertisements
+// repair the rest
+const int SYNC_TRIES = 8;
+
+class SyncHeader {
+public:
+    std::string sender;
+    uint32_t id;
+    uint16_t seq;
+    // datagrams of the transfer, data datagrams only
+    uint16_t count;
+};
+
+// largest segment a reliable transfer from name carries, so that a datagram with its header still fits
+// SEGMENT_SIZE; answers sent by reliable transfers are cut at this size
+size_t syncSegmentSize(const std::string &name);
+
+// parse the header of a sync datagram, the payload of a data datagram begins at offset
+bool parseSync(const char *buf, size_t len, SyncHeader &header, size_t &offset);
+
+// the sending half of reliable transfers, by selective repeat: each datagram is acknowledged on its
+// own and only those not acknowledged in time are sent again
+class SyncSender {
+public:
+    // retransmissions, read by the caller for its counters
+    unsigned long retransmitted;
+
+    SyncSender(const std::string &n);
+
+    // transfer the packets of ads, replacing any unfinished transfer to the same neighbor; packets
+    // longer than syncSegmentSize are cut into segments of that size
+    void start(const class Advertisements &ads);
+
+    // note an acknowledgement, false if it matches no datagram in flight
+    bool ack(const SyncHeader &header);
+
+    // pass every datagram due at now to send, with the neighbor and its address, the datagram stays
+    // valid until the next call to the sender; return the time the next one is due, negative if
+    // nothing is in flight
+    double poll(double now, const std::function<void(const std::string &, const struct sockaddr_in &,
+        const std::string &)> &send);
+
+private:
+    class Transfer {
+    public:
+        uint32_t id;
+        struct sockaddr_in addr;
+        // with their headers
+        std::vector<std::string> datagrams;
+        // when each datagram is due to be sent (again), 0 if it was never sent
+        std::vector<double> due;
+        std::vector<int> tries;
+        std::vector<bool> acked;
+        // first datagram not acknowledged, the window begins there
+        size_t base;
+    };
+
+    std::string name;
+    // starts at random, so a restarted sender does not reuse the ids a receiver still remembers
+    uint32_t nextId;
+    // <neighbor name, transfer>
+    std::map<std::string, Transfer> transfers;
+};
+
+// the receiving half: acknowledges every data datagram and passes each one on only once
+class SyncReceiver {
+public:
+    SyncReceiver(const std::string &n) : name(n) {}
+
+    // build the acknowledgement of a data datagram, return true if it was not received before
+    bool receive(const SyncHeader &header, std::string &ack);
+
+private:
+    std::string name;
+    // <sender, <transfer id, datagrams received>>
+    std::map<std::string, std::pair<uint32_t, std::vector<bool> > > received;
+};
+
+#endif
@@ -0,0 +1,29 @@
+#include "topology.h"
+
+int main(int argc, char *argv[]) {
+    if ((argc < 4) || (argc > 7)) {
+        std::cout << "usage: " << argv[0] << " <ring|grid|geometric|scalefree> <nodes> <directory> [seed] [base_port] [zones]"
+            << std::endl;
+        exit(0);
+    }
+
+    auto n = atoi(argv[2]);
+    unsigned seed = (argc > 4) ? atoi(argv[4]) : 1;
+    auto basePort = (argc > 5) ? atoi(argv[5]) : 3031;
+    Topology topo;
+    if (!topo.generate(argv[1], n, seed, basePort)) {
+        std::cout << "invalid topology " << argv[1] << " of " << argv[2] << " nodes" << std::endl;
+        exit(0);
+    }
+    if (argc > 6) {
+        topo.partition(atoi(argv[6]));
+    }
+    if (!topo.write(argv[3])) {
+        std::cout << "cannot write to " << argv[3] << std::endl;
+        exit(0);
+    }
+
+    std::cout << "## " << argv[1] << ": " << topo.names.size() << " hosts, " << topo.edges() << " links, ports "
+        << basePort << " to " << (basePort + n - 1) << std::endl;
+    return 0;
+}
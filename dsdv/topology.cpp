@@ -0,0 +1,253 @@
+#include <algorithm>
+#include <cmath>
+#include <functional>
+#include <numeric>
+#include <queue>
+#include "topology.h"
+
+bool Topology::generate(const std::string &type, int n, unsigned seed, int basePort) {
+    if (n <= 0) {
+        return false;
+    }
+    rng.seed(seed);
+    reset(n, basePort);
+
+    if (type == "ring") {
+        ring(n);
+    } else if (type == "grid") {
+        grid(n);
+    } else if (type == "geometric") {
+        geometric(n);
+    } else if (type == "scalefree") {
+        scaleFree(n);
+    } else {
+        return false;
+    }
+
+    return true;
+}
+
+std::map<std::string, class NeighborInfo> Topology::neighbors(int i) const {
+    std::map<std::string, class NeighborInfo> ret;
+    for (const auto &it : adjacency[i]) {
+        ret[names[it.first]] = NeighborInfo(it.second, ports[it.first]);
+    }
+    return ret;
+}
+
+bool Topology::write(const std::string &dir) const {
+    for (size_t i = 0; i < names.size(); ++i) {
+        std::ofstream fout((dir + "/" + names[i] + ".dat").c_str(), std::ofstream::out);
+        if (!fout.good()) {
+            fout.close();
+            return false;
+        }
+
+        // <count> <name>, then <neighbor> <metric> <port> per line
+        fout << adjacency[i].size() << ' ' << names[i] << std::endl;
+        for (const auto &it : adjacency[i]) {
+            fout << names[it.first] << ' ' << setiosflags(std::ios::fixed) << std::setprecision(1)
+                << it.second << ' ' << ports[it.first] << std::endl;
+        }
+        fout.close();
+    }
+
+    return true;
+}
+
+void Topology::partition(int count) {
+    auto n = static_cast<int>(names.size());
+    count = std::max(1, std::min(count, n));
+    // breadth first from all seeds at once, every host joins the zone that reaches it first
+    zones.assign(n, -1);
+    std::queue<int> queue;
+    for (auto z = 0; z < count; ++z) {
+        auto seed = static_cast<int>(static_cast<long>(z) * n / count);
+        zones[seed] = z;
+        queue.push(seed);
+    }
+    while (!queue.empty()) {
+        auto v = queue.front();
+        queue.pop();
+        for (const auto &it : adjacency[v]) {
+            if (zones[it.first] < 0) {
+                zones[it.first] = zones[v];
+                queue.push(it.first);
+            }
+        }
+    }
+
+    for (auto i = 0; i < n; ++i) {
+        names[i] = "z" + std::to_string(zones[i]) + ".n" + std::to_string(i);
+    }
+}
+
+std::vector<double> Topology::shortestPaths(int source, bool withinZone) const {
+    typedef std::pair<double, int> Item;
+    std::vector<double> dist(names.size(), MAX);
+    std::priority_queue<Item, std::vector<Item>, std::greater<Item> > heap;
+
+    dist[source] = 0;
+    heap.push(Item(0, source));
+    while (!heap.empty()) {
+        auto top = heap.top();
+        heap.pop();
+        if (top.first > dist[top.second]) {
+            continue;
+        }
+        for (const auto &it : adjacency[top.second]) {
+            if (withinZone && (zones[it.first] != zones[source])) {
+                continue;
+            }
+            if (top.first + it.second < dist[it.first]) {
+                dist[it.first] = top.first + it.second;
+                heap.push(Item(dist[it.first], it.first));
+            }
+        }
+    }
+
+    return dist;
+}
+
+size_t Topology::edges() const {
+    size_t ret = 0;
+    for (const auto &it : adjacency) {
+        ret += it.size();
+    }
+    return ret / 2;
+}
+
+void Topology::reset(int n, int basePort) {
+    names.clear();
+    ports.clear();
+    zones.clear();
+    adjacency.assign(n, std::map<int, double>());
+    for (auto i = 0; i < n; ++i) {
+        names.push_back("n" + std::to_string(i));
+        ports.push_back(basePort + i);
+    }
+}
+
+void Topology::link(int a, int b, double metric) {
+    if (a == b) {
+        return;
+    }
+    adjacency[a][b] = metric;
+    adjacency[b][a] = metric;
+}
+
+// integral metric in [1, 10], written as "3.0" like the hand-written files
+double Topology::randomMetric() {
+    return std::uniform_int_distribution<int>(1, 10)(rng);
+}
+
+void Topology::ring(int n) {
+    for (auto i = 0; (i < n) && (n > 1); ++i) {
+        link(i, (i + 1) % n, randomMetric());
+    }
+}
+
+void Topology::grid(int n) {
+    auto side = static_cast<int>(std::ceil(std::sqrt(n)));
+    for (auto i = 0; i < n; ++i) {
+        if ((i % side != side - 1) && (i + 1 < n)) {
+            link(i, i + 1, randomMetric());
+        }
+        if (i + side < n) {
+            link(i, i + side, randomMetric());
+        }
+    }
+}
+
+// hosts uniformly placed in the unit square, linked when closer than the connectivity radius,
+// metric is the distance rounded to 0.1 (in hundredths of the square side)
+void Topology::geometric(int n) {
+    std::uniform_real_distribution<double> uniform(0, 1);
+    std::vector<double> x(n), y(n);
+    for (auto i = 0; i < n; ++i) {
+        x[i] = uniform(rng);
+        y[i] = uniform(rng);
+    }
+    auto distance = [&](int a, int b) {
+        return std::max(0.1, std::round(std::hypot(x[a] - x[b], y[a] - y[b]) * 1000) / 10);
+    };
+
+    auto radius = std::min(1.0, std::sqrt(2.0 * std::log(n + 1) / (M_PI * n)));
+    auto cells = std::max(1, static_cast<int>(1 / radius));
+    std::vector<std::vector<int> > buckets(cells * cells);
+    auto cellOf = [&](double v) { return std::min(cells - 1, static_cast<int>(v * cells)); };
+    for (auto i = 0; i < n; ++i) {
+        buckets[cellOf(x[i]) * cells + cellOf(y[i])].push_back(i);
+    }
+    for (auto i = 0; i < n; ++i) {
+        auto cx = cellOf(x[i]), cy = cellOf(y[i]);
+        for (auto dx = std::max(0, cx - 1); dx <= std::min(cells - 1, cx + 1); ++dx) {
+            for (auto dy = std::max(0, cy - 1); dy <= std::min(cells - 1, cy + 1); ++dy) {
+                for (auto j : buckets[dx * cells + dy]) {
+                    if ((j > i) && (std::hypot(x[i] - x[j], y[i] - y[j]) < radius)) {
+                        link(i, j, distance(i, j));
+                    }
+                }
+            }
+        }
+    }
+
+    // join every other component to the closest host already connected to n0
+    std::vector<int> parent(n);
+    std::iota(parent.begin(), parent.end(), 0);
+    std::function<int(int)> find = [&](int v) { return (parent[v] == v) ? v : (parent[v] = find(parent[v])); };
+    for (auto i = 0; i < n; ++i) {
+        for (const auto &it : adjacency[i]) {
+            parent[find(i)] = find(it.first);
+        }
+    }
+    std::map<int, std::vector<int> > components;
+    for (auto i = 0; i < n; ++i) {
+        components[find(i)].push_back(i);
+    }
+    auto connected = components[find(0)];
+    for (const auto &it : components) {
+        if (it.first == find(0)) {
+            continue;
+        }
+        auto a = it.second[0], b = connected[0];
+        for (auto i : it.second) {
+            for (auto j : connected) {
+                if (std::hypot(x[i] - x[j], y[i] - y[j]) < std::hypot(x[a] - x[b], y[a] - y[b])) {
+                    a = i;
+                    b = j;
+                }
+            }
+        }
+        link(a, b, distance(a, b));
+        connected.insert(connected.end(), it.second.begin(), it.second.end());
+    }
+}
+
+// Barabasi-Albert preferential attachment, every new host links to two existing hosts
+void Topology::scaleFree(int n) {
+    const int m = 2;
+    // every host appears once per incident link
+    std::vector<int> ends;
+    for (auto i = 1; i < std::min(n, m + 1); ++i) {
+        for (auto j = 0; j < i; ++j) {
+            link(i, j, randomMetric());
+            ends.push_back(i);
+            ends.push_back(j);
+        }
+    }
+    for (auto i = m + 1; i < n; ++i) {
+        std::vector<int> targets;
+        while (static_cast<int>(targets.size()) < m) {
+            auto t = ends[std::uniform_int_distribution<size_t>(0, ends.size() - 1)(rng)];
+            if (std::find(targets.begin(), targets.end(), t) == targets.end()) {
+                targets.push_back(t);
+            }
+        }
+        for (auto t : targets) {
+            link(i, t, randomMetric());
+            ends.push_back(i);
+            ends.push_back(t);
+        }
+    }
+}
@@ -0,0 +1,48 @@
+#ifndef TOPOLOGY_H_
+#define TOPOLOGY_H_
+
+#include <random>
+#include "dsdv.h"
+
+// undirected weighted graph of hosts, named n0, n1, ... and bound to consecutive ports
+class Topology {
+public:
+    std::vector<std::string> names;
+    std::vector<int> ports;
+    // adjacency[i] ==> <neighbor index, metric>
+    std::vector<std::map<int, double> > adjacency;
+    // zone index of every host, empty unless partitioned
+    std::vector<int> zones;
+
+    // generate a connected topology of type ring, grid, geometric or scalefree
+    bool generate(const std::string &type, int n, unsigned seed, int basePort = 3031);
+
+    // split the hosts into count connected zones grown from evenly spread seeds,
+    // host names become "z<zone>.n<index>"
+    void partition(int count);
+
+    // neighbor configuration of host i, in the same form as loadNeighborFile() returns
+    std::map<std::string, class NeighborInfo> neighbors(int i) const;
+
+    // write one <name>.dat neighbor file per host into dir
+    bool write(const std::string &dir) const;
+
+    // shortest path costs from source to every host by Dijkstra, MAX if unreachable,
+    // only through hosts of the source's zone if withinZone
+    std::vector<double> shortestPaths(int source, bool withinZone = false) const;
+
+    size_t edges() const;
+
+private:
+    std::mt19937 rng;
+
+    void reset(int n, int basePort);
+    void link(int a, int b, double metric);
+    double randomMetric();
+    void ring(int n);
+    void grid(int n);
+    void geometric(int n);
+    void scaleFree(int n);
+};
+
+#endif
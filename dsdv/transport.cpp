@@ -0,0 +1,381 @@
+#include <sys/eventfd.h>
+#include <sys/mman.h>
+#include <sys/un.h>
+#include <fcntl.h>
+#include <cerrno>
+#include "transport.h"
+
+// length of the message that marks the rest of the ring as unused
+static const uint32_t WRAP = 0xffffffff;
+
+// a neighbor that does not answer within this long is reached by UDP, and asked again a second later
+static const int ATTACH_TIMEOUT_MS = 100;
+static const int ATTACH_RETRY_MS = 1000;
+
+static size_t padded(size_t len) {
+    return 8 + ((len + 7) & ~static_cast<size_t>(7));
+}
+
+int parseTransport(const std::string &str) {
+    if (str == "udp") {
+        return TRANSPORT_UDP;
+    }
+    if (str == "shm") {
+        return TRANSPORT_SHM;
+    }
+    return -1;
+}
+
+std::string ringPath(int port) {
+    return "/tmp/dsdv-" + std::to_string(port) + ".ring";
+}
+
+Ring::~Ring() {
+    if (header) {
+        munmap(header, sizeof(RingHeader) + RING_SIZE);
+    }
+}
+
+bool Ring::map(int fd, bool create) {
+    auto length = sizeof(RingHeader) + RING_SIZE;
+    if ((create) && (ftruncate(fd, length) < 0)) {
+        return false;
+    }
+    auto p = mmap(NULL, length, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    if (p == MAP_FAILED) {
+        return false;
+    }
+    header = static_cast<RingHeader *>(p);
+    base = static_cast<char *>(p) + sizeof(RingHeader);
+    taken = header->head.load(std::memory_order_acquire);
+    return true;
+}
+
+bool Ring::push(const char *data, size_t len) {
+    auto need = padded(len);
+    if (need > RING_SIZE / 2) {
+        return false;
+    }
+    auto tail = header->tail.load(std::memory_order_relaxed);
+    auto pos = tail % RING_SIZE;
+    // a message that would cross the end starts over at the beginning
+    auto skip = (RING_SIZE - pos < need) ? (RING_SIZE - pos) : 0;
+    if (tail + skip + need - header->head.load(std::memory_order_acquire) > RING_SIZE) {
+        return false;
+    }
+    if (skip > 0) {
+        memcpy(base + pos, &WRAP, sizeof(WRAP));
+        pos = 0;
+    }
+    uint32_t length = len;
+    memcpy(base + pos, &length, sizeof(length));
+    memcpy(base + pos + 8, data, len);
+
+    // the store of tail and the load of sleeping are ordered against the consumer's store of
+    // sleeping and load of tail, so either it sees the message or we see it sleeping
+    header->tail.store(tail + skip + need, std::memory_order_seq_cst);
+    if ((header->sleeping.load(std::memory_order_seq_cst) != 0) &&
+            (header->sleeping.exchange(0, std::memory_order_seq_cst) != 0)) {
+        uint64_t one = 1;
+        if (write(event, &one, sizeof(one)) < 0) {
+            // the counter is already set, the consumer is woken up anyway
+        }
+    }
+    return true;
+}
+
+bool Ring::next(char *&data, size_t &len) {
+    auto tail = header->tail.load(std::memory_order_acquire);
+    while (taken != tail) {
+        auto pos = taken % RING_SIZE;
+        uint32_t length;
+        memcpy(&length, base + pos, sizeof(length));
+        if (length == WRAP) {
+            taken += RING_SIZE - pos;
+            continue;
+        }
+        if (padded(length) > RING_SIZE - pos) {
+            // only a broken producer gets here, everything it wrote is dropped
+            taken = tail;
+            return false;
+        }
+        data = base + pos + 8;
+        len = length;
+        taken += padded(length);
+        return true;
+    }
+    return false;
+}
+
+void Ring::release() {
+    header->head.store(taken, std::memory_order_release);
+}
+
+bool Ring::sleep() {
+    header->sleeping.store(1, std::memory_order_seq_cst);
+    return header->tail.load(std::memory_order_seq_cst) == taken;
+}
+
+Transport::Transport(int f, int p, int k) : fd(f), port(p), kind(k), event(-1), listener(-1), readable(true) {}
+
+Transport::~Transport() {
+    for (auto &it : outgoing) {
+        drop(it.second);
+    }
+    for (auto &it : incoming) {
+        close(it.conn);
+    }
+    if (listener >= 0) {
+        close(listener);
+        unlink(ringPath(port).c_str());
+    }
+    if (event >= 0) {
+        close(event);
+    }
+}
+
+bool Transport::open() {
+    if (kind == TRANSPORT_UDP) {
+        return true;
+    }
+    event = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    if (event < 0) {
+        std::cerr << "create eventfd error" << std::endl;
+        return false;
+    }
+    listener = socketListen(ringPath(port));
+    if (listener < 0) {
+        return false;
+    }
+    fcntl(listener, F_SETFL, fcntl(listener, F_GETFL) | O_NONBLOCK);
+    return true;
+}
+
+void Transport::check() {
+    if (outgoing.empty()) {
+        return;
+    }
+    // a ring is only read by the process that handed it out, its connection closes with it
+    checks.clear();
+    for (const auto &it : outgoing) {
+        if (it.second.conn >= 0) {
+            checks.push_back({it.second.conn, POLLIN, 0});
+        }
+    }
+    if ((checks.empty()) || (poll(checks.data(), checks.size(), 0) <= 0)) {
+        return;
+    }
+    for (const auto &it : checks) {
+        if (it.revents == 0) {
+            continue;
+        }
+        for (auto &out : outgoing) {
+            if (out.second.conn == it.fd) {
+                drop(out.second);
+            }
+        }
+    }
+}
+
+void Transport::send(SendBatch &batch, const struct sockaddr_in &addr, const char *data, size_t len, size_t segment) {
+    if (kind == TRANSPORT_SHM) {
+        auto &out = outgoing[ntohs(addr.sin_port)];
+        auto now = std::chrono::steady_clock::now();
+        if ((!out.ring) && (now - out.attempted >= std::chrono::milliseconds(ATTACH_RETRY_MS))) {
+            out.attempted = now;
+            attach(ntohs(addr.sin_port), out);
+        }
+        if (out.ring) {
+            // segments are messages of their own, as they would be datagrams
+            auto step = ((segment == 0) || (len <= segment)) ? len : segment;
+            size_t offset = 0;
+            while ((offset < len) && (out.ring->push(data + offset, std::min(step, len - offset)))) {
+                offset += std::min(step, len - offset);
+            }
+            // what the ring had no room for is dropped, as a full socket buffer would
+            return;
+        }
+    }
+    batch.add(addr, data, len, segment);
+}
+
+bool Transport::attach(int neighbor, Outgoing &out) {
+    struct sockaddr_un sun;
+    auto path = ringPath(neighbor);
+    if (path.size() >= sizeof(sun.sun_path)) {
+        return false;
+    }
+    auto conn = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    if (conn < 0) {
+        return false;
+    }
+    struct timeval timeout = {0, ATTACH_TIMEOUT_MS * 1000};
+    setsockopt(conn, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+    setsockopt(conn, SOL_SOCKET, SO_SNDTIMEO, &timeout, sizeof(timeout));
+    memset((char *)&sun, 0, sizeof(struct sockaddr_un));
+    sun.sun_family = AF_UNIX;
+    memcpy(sun.sun_path, path.data(), path.size());
+    int32_t self = port;
+    if ((connect(conn, (struct sockaddr *)&sun, sizeof(struct sockaddr_un)) < 0) ||
+            (write(conn, &self, sizeof(self)) != sizeof(self))) {
+        close(conn);
+        return false;
+    }
+
+    // the ring and the eventfd of the neighbor come back as SCM_RIGHTS
+    char byte;
+    struct iovec iov = {&byte, 1};
+    char control[CMSG_SPACE(2 * sizeof(int))];
+    struct msghdr msg;
+    memset(&msg, 0, sizeof(msg));
+    msg.msg_iov = &iov;
+    msg.msg_iovlen = 1;
+    msg.msg_control = control;
+    msg.msg_controllen = sizeof(control);
+    auto cmsg = (recvmsg(conn, &msg, MSG_CMSG_CLOEXEC) == 1) ? CMSG_FIRSTHDR(&msg) : NULL;
+    if ((cmsg == NULL) || (cmsg->cmsg_level != SOL_SOCKET) || (cmsg->cmsg_type != SCM_RIGHTS) ||
+            (cmsg->cmsg_len != CMSG_LEN(2 * sizeof(int)))) {
+        close(conn);
+        return false;
+    }
+    int fds[2];
+    memcpy(fds, CMSG_DATA(cmsg), sizeof(fds));
+
+    std::unique_ptr<Ring> ring(new Ring());
+    auto mapped = ring->map(fds[0], false);
+    close(fds[0]);
+    if (!mapped) {
+        close(fds[1]);
+        close(conn);
+        return false;
+    }
+    ring->event = fds[1];
+    out.conn = conn;
+    out.ring = std::move(ring);
+    return true;
+}
+
+void Transport::accept() {
+    for (;;) {
+        auto conn = accept4(listener, NULL, NULL, SOCK_CLOEXEC);
+        if (conn < 0) {
+            return;
+        }
+        struct timeval timeout = {0, ATTACH_TIMEOUT_MS * 1000};
+        setsockopt(conn, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+        setsockopt(conn, SOL_SOCKET, SO_SNDTIMEO, &timeout, sizeof(timeout));
+        int32_t neighbor;
+        auto memfd = memfd_create("dsdv-ring", MFD_CLOEXEC);
+        std::unique_ptr<Ring> ring(new Ring());
+        if ((read(conn, &neighbor, sizeof(neighbor)) != sizeof(neighbor)) || (memfd < 0) ||
+                (!ring->map(memfd, true))) {
+            if (memfd >= 0) {
+                close(memfd);
+            }
+            close(conn);
+            continue;
+        }
+
+        char byte = 0;
+        struct iovec iov = {&byte, 1};
+        char control[CMSG_SPACE(2 * sizeof(int))];
+        memset(control, 0, sizeof(control));
+        struct msghdr msg;
+        memset(&msg, 0, sizeof(msg));
+        msg.msg_iov = &iov;
+        msg.msg_iovlen = 1;
+        msg.msg_control = control;
+        msg.msg_controllen = sizeof(control);
+        auto cmsg = CMSG_FIRSTHDR(&msg);
+        cmsg->cmsg_level = SOL_SOCKET;
+        cmsg->cmsg_type = SCM_RIGHTS;
+        cmsg->cmsg_len = CMSG_LEN(2 * sizeof(int));
+        int fds[2] = {memfd, event};
+        memcpy(CMSG_DATA(cmsg), fds, sizeof(fds));
+        auto sent = sendmsg(conn, &msg, MSG_NOSIGNAL);
+        close(memfd);
+        if (sent != 1) {
+            close(conn);
+            continue;
+        }
+        incoming.push_back(Incoming());
+        incoming.back().conn = conn;
+        incoming.back().ring = std::move(ring);
+    }
+}
+
+void Transport::drop(Outgoing &out) {
+    if (out.ring) {
+        close(out.ring->event);
+        out.ring.reset();
+    }
+    if (out.conn >= 0) {
+        close(out.conn);
+    }
+    out.conn = -1;
+}
+
+int Transport::receive(ReceiveBatch &batch) {
+    if (kind == TRANSPORT_UDP) {
+        return socketReceiveBatch(fd, batch);
+    }
+    for (auto &it : incoming) {
+        it.ring->release();
+    }
+
+    auto &fds = polls;
+    for (;;) {
+        // the socket is only read when poll said it had datagrams, so that rings cost no system call
+        if (readable) {
+            socketReceiveBatch(fd, batch, false);
+            readable = (batch.count > 0);
+        } else {
+            batch.clear();
+        }
+        for (auto &it : incoming) {
+            char *data;
+            size_t len;
+            for (auto i = 0; (i < BATCH) && (it.ring->next(data, len)); ++i) {
+                batch.add(data, len);
+            }
+        }
+        if (batch.count > 0) {
+            return batch.count;
+        }
+
+        bool empty = true;
+        for (auto &it : incoming) {
+            empty = (it.ring->sleep()) && (empty);
+        }
+        if (!empty) {
+            continue;
+        }
+        fds.clear();
+        fds.push_back({fd, POLLIN, 0});
+        fds.push_back({event, POLLIN, 0});
+        fds.push_back({listener, POLLIN, 0});
+        for (const auto &it : incoming) {
+            fds.push_back({it.conn, POLLIN, 0});
+        }
+        if (poll(fds.data(), fds.size(), -1) < 0) {
+            continue;
+        }
+        readable = (fds[0].revents != 0);
+        if (fds[1].revents != 0) {
+            uint64_t value;
+            if (read(event, &value, sizeof(value)) < 0) {
+                // reset by a spurious wakeup already
+            }
+        }
+        // a connection only becomes readable when the producing host is gone
+        for (size_t i = fds.size(); i > 3; --i) {
+            if (fds[i - 1].revents != 0) {
+                close(incoming[i - 4].conn);
+                incoming.erase(incoming.begin() + (i - 4));
+            }
+        }
+        if (fds[2].revents != 0) {
+            accept();
+        }
+    }
+}
@@ -0,0 +1,134 @@
+#ifndef TRANSPORT_H_
+#define TRANSPORT_H_
+
+#include <atomic>
+#include <chrono>
+#include <map>
+#include <memory>
+#include <poll.h>
+#include "util.h"
+
+// bytes of messages one ring holds
+const size_t RING_SIZE = 1 << 20;
+
+// how a host reaches its neighbors: UDP only, or shared memory rings to those on this machine
+enum { TRANSPORT_UDP = 0, TRANSPORT_SHM };
+
+// TRANSPORT_* of "udp" or "shm", -1 if unknown
+int parseTransport(const std::string &str);
+
+// rendezvous socket where the host bound to port hands out rings
+std::string ringPath(int port);
+
+// start of a ring, head and tail on cache lines of their own
+class RingHeader {
+public:
+    // bytes ever consumed, only written by the consumer
+    std::atomic<uint64_t> head;
+    char pad0[56];
+    // bytes ever produced, only written by the producer
+    std::atomic<uint64_t> tail;
+    char pad1[56];
+    // set by the consumer before it blocks, the producer then writes the eventfd
+    std::atomic<uint32_t> sleeping;
+    char pad2[60];
+};
+
+// single producer, single consumer queue of messages in shared memory: every message is a 4-byte
+// length and its bytes, padded to 8 and never split by the end of the ring, so that the consumer
+// reads it in place
+class Ring {
+public:
+    // eventfd of the consumer, written when it sleeps
+    int event;
+
+    Ring() : event(-1), header(nullptr), base(nullptr), taken(0) {}
+    ~Ring();
+
+    // map the ring in fd, which create sizes and clears
+    bool map(int fd, bool create);
+
+    // producer: append a message, false if it does not fit
+    bool push(const char *data, size_t len);
+
+    // consumer: the next message not taken yet, false if there is none
+    bool next(char *&data, size_t &len);
+
+    // consumer: give the space of every message taken back to the producer
+    void release();
+
+    // consumer: ask for a wakeup, false if a message arrived meanwhile and it must not block
+    bool sleep();
+
+private:
+    RingHeader *header;
+    char *base;
+    // consumer's position, ahead of head by the messages still in use
+    uint64_t taken;
+
+    Ring(const Ring &) = delete;
+    Ring &operator=(const Ring &) = delete;
+};
+
+// carries advertisements between neighbors: over UDP, or with TRANSPORT_SHM through one ring per
+// ordered pair of hosts that both run on this machine with it; the sender thread and the receiver
+// thread each use their own half
+class Transport {
+public:
+    Transport(int fd, int port, int kind);
+    ~Transport();
+
+    // create the eventfd and the rendezvous socket, before any thread starts
+    bool open();
+
+    // sender: drop the rings of neighbors that went away, once per round
+    void check();
+
+    // sender: push a packet cut into segments into the ring of the neighbor at addr, or queue it in batch
+    void send(SendBatch &batch, const struct sockaddr_in &addr, const char *data, size_t len, size_t segment);
+
+    // receiver: give back the messages of the last batch, block until datagrams or messages
+    // arrive and take what is pending of both
+    int receive(ReceiveBatch &batch);
+
+private:
+    class Outgoing {
+    public:
+        Outgoing() : conn(-1) {}
+
+        int conn;
+        std::unique_ptr<Ring> ring;
+        std::chrono::steady_clock::time_point attempted;
+    };
+
+    class Incoming {
+    public:
+        int conn;
+        std::unique_ptr<Ring> ring;
+    };
+
+    int fd;
+    int port;
+    int kind;
+    int event;
+    int listener;
+    // whether the socket had datagrams the last time it was polled
+    bool readable;
+    // <port, ring>, sender only
+    std::map<int, Outgoing> outgoing;
+    // receiver only
+    std::vector<Incoming> incoming;
+    // reused by check and receive, so neither allocates
+    std::vector<struct pollfd> checks, polls;
+
+    // sender: get a ring from the host at port, false if it has none for us
+    bool attach(int port, Outgoing &out);
+    // receiver: hand a ring to a connecting host
+    void accept();
+    void drop(Outgoing &out);
+
+    Transport(const Transport &) = delete;
+    Transport &operator=(const Transport &) = delete;
+};
+
+#endif
@@ -1,5 +1,20 @@
+#include <sys/un.h>
+#include <netinet/in.h>
+#include <algorithm>
+#include <cerrno>
 #include "util.h"
 
+// from linux/udp.h, which older C libraries do not provide
+#ifndef SOL_UDP
+#define SOL_UDP 17
+#endif
+#ifndef UDP_SEGMENT
+#define UDP_SEGMENT 103
+#endif
+#ifndef UDP_GRO
+#define UDP_GRO 104
+#endif
+
 int socketBind(int port) {
     auto fd = socket(AF_INET, SOCK_DGRAM, 0);
     if (fd < 0) {
@@ -23,11 +38,59 @@ int socketBind(int port) {
     return fd;
 }
 
+int socketListen(const std::string &path) {
+    struct sockaddr_un sun;
+    if (path.size() >= sizeof(sun.sun_path)) {
+        std::cerr << "socket path too long" << std::endl;
+        return -1;
+    }
+
+    auto fd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    if (fd < 0) {
+        std::cerr << "create socket error" << std::endl;
+        return -1;
+    }
+
+    memset((char *)&sun, 0, sizeof(struct sockaddr_un));
+    sun.sun_family = AF_UNIX;
+    memcpy(sun.sun_path, path.data(), path.size());
+    unlink(path.c_str());
+
+    if ((bind(fd, (struct sockaddr *)&sun, sizeof(struct sockaddr_un)) < 0) || (listen(fd, 8) < 0)) {
+        std::cerr << "bind fd error" << std::endl;
+        close(fd);
+        return -1;
+    }
+
+    return fd;
+}
+
+bool socketWriteAll(int fd, const std::string &str) {
+    for (size_t sent = 0; sent < str.size(); ) {
+        // a peer that closed its end fails the send instead of killing the process with SIGPIPE
+        auto ret = send(fd, str.data() + sent, str.size() - sent, MSG_NOSIGNAL);
+        if (ret <= 0) {
+            return false;
+        }
+        sent += ret;
+    }
+    return true;
+}
+
+int socketOffload(int fd) {
+    int ret = 0, zero = 0, one = 1;
+    // a zero default segment size keeps plain sends unchanged, per-message sizes come as control messages
+    if (setsockopt(fd, SOL_UDP, UDP_SEGMENT, &zero, sizeof(zero)) == 0) {
+        ret |= OFFLOAD_GSO;
+    }
+    if (setsockopt(fd, SOL_UDP, UDP_GRO, &one, sizeof(one)) == 0) {
+        ret |= OFFLOAD_GRO;
+    }
+    return ret;
+}
+
 void socketSend(int fd, int port, const std::string &str) {
-    char buf[BUFLEN];
-    memset(buf, 0, BUFLEN);
-    strcpy(buf, str.c_str());
-    //std::cout << "socketSend fd " << fd << " port " << port << " buf " << buf << " size " << strlen(buf) << std::endl;
+    //std::cout << "socketSend fd " << fd << " port " << port << " size " << str.size() << std::endl;
 
     struct sockaddr_in sin;
     memset((char *)&sin, 0, sizeof(struct sockaddr_in));
@@ -36,7 +99,8 @@ void socketSend(int fd, int port, const std::string &str) {
     sin.sin_port = htons(port);
     sin.sin_addr.s_addr = inet_addr("127.0.0.1");
 
-    if (sendto(fd, buf, BUFLEN - 1, 0, (struct sockaddr *)&sin, sizeof(struct sockaddr_in)) < 0) {
+    // the string is sent as it is, a table of any size is no longer copied into a fixed buffer
+    if (sendto(fd, str.data(), str.size(), 0, (struct sockaddr *)&sin, sizeof(struct sockaddr_in)) < 0) {
         std::cerr << "socket send error" << std::endl;
         exit(0);
     }
@@ -44,17 +108,157 @@ void socketSend(int fd, int port, const std::string &str) {
 
 std::string socketReceive(int fd) {
     //std::cout << "socketReceive fd " << fd << std::endl;
-    char buf[BUFLEN];
-    memset(buf, 0, BUFLEN);
+    std::vector<char> buf(GRO_BUFLEN);
 
     struct sockaddr_in sin;
     memset((char *)&sin, 0, sizeof(struct sockaddr_in));
     
     socklen_t len = sizeof(struct sockaddr_in);
-    if (recvfrom(fd, buf, BUFLEN - 1, 0, (struct sockaddr *)&sin, &len) <= 0) {
-        std::cerr << "socket receive error buf " << buf << std::endl;
+    auto ret = recvfrom(fd, buf.data(), buf.size(), 0, (struct sockaddr *)&sin, &len);
+    if (ret <= 0) {
+        std::cerr << "socket receive error" << std::endl;
+        exit(0);
+    }
+
+    return std::string(buf.data(), ret);
+}
+
+ReceiveBatch::ReceiveBatch(size_t s) : count(0), slot(s), bufs(BATCH * s), controls(BATCH * CMSG_SPACE(sizeof(int))),
+        iovs(BATCH), msgs(BATCH) {
+    memset(msgs.data(), 0, BATCH * sizeof(struct mmsghdr));
+    for (auto i = 0; i < BATCH; ++i) {
+        iovs[i].iov_base = &bufs[i * slot];
+        iovs[i].iov_len = slot;
+        msgs[i].msg_hdr.msg_iov = &iovs[i];
+        msgs[i].msg_hdr.msg_iovlen = 1;
+    }
+}
+
+void SendBatch::add(const struct sockaddr_in &addr, const char *data, size_t len, size_t segment) {
+    struct iovec iov;
+    // one message per datagram, or per GSO_SEGMENTS segments with GSO
+    auto step = ((segment == 0) || (len <= segment)) ? len : (gso ? segment * GSO_SEGMENTS : segment);
+    size_t offset = 0;
+    do {
+        iov.iov_base = const_cast<char *>(data + offset);
+        iov.iov_len = std::min(step, len - offset);
+        addrs.push_back(addr);
+        iovs.push_back(iov);
+        segments.push_back((iov.iov_len > segment) ? segment : 0);
+        offset += iov.iov_len;
+    } while (offset < len);
+}
+
+struct sockaddr_in socketAddress(int port) {
+    struct sockaddr_in sin;
+    memset((char *)&sin, 0, sizeof(struct sockaddr_in));
+
+    sin.sin_family = AF_INET;
+    sin.sin_port = htons(port);
+    sin.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+
+    return sin;
+}
+
+void socketBroadcast(int fd, const std::vector<struct sockaddr_in> &addrs, const std::string &str) {
+    struct iovec iov;
+    iov.iov_base = const_cast<char *>(str.data());
+    iov.iov_len = str.size();
+
+    // every message shares the same payload, only the destination differs
+    std::vector<struct mmsghdr> msgs(addrs.size());
+    memset(msgs.data(), 0, msgs.size() * sizeof(struct mmsghdr));
+    for (size_t i = 0; i < addrs.size(); ++i) {
+        msgs[i].msg_hdr.msg_name = const_cast<struct sockaddr_in *>(&addrs[i]);
+        msgs[i].msg_hdr.msg_namelen = sizeof(struct sockaddr_in);
+        msgs[i].msg_hdr.msg_iov = &iov;
+        msgs[i].msg_hdr.msg_iovlen = 1;
+    }
+
+    for (size_t sent = 0; sent < msgs.size(); ) {
+        auto ret = sendmmsg(fd, &msgs[sent], msgs.size() - sent, 0);
+        if (ret < 0) {
+            std::cerr << "socket broadcast error" << std::endl;
+            exit(0);
+        }
+        sent += ret;
+    }
+}
+
+void socketSendBatch(int fd, SendBatch &batch) {
+    // headers point into addrs and iovs, so they are only built once both stopped growing
+    batch.msgs.resize(batch.addrs.size());
+    batch.controls.resize(batch.addrs.size() * CMSG_SPACE(sizeof(uint16_t)));
+    memset(batch.msgs.data(), 0, batch.msgs.size() * sizeof(struct mmsghdr));
+    memset(batch.controls.data(), 0, batch.controls.size());
+    for (size_t i = 0; i < batch.msgs.size(); ++i) {
+        auto &hdr = batch.msgs[i].msg_hdr;
+        hdr.msg_name = &batch.addrs[i];
+        hdr.msg_namelen = sizeof(struct sockaddr_in);
+        hdr.msg_iov = &batch.iovs[i];
+        hdr.msg_iovlen = 1;
+        if (batch.segments[i] > 0) {
+            // the kernel cuts the message into datagrams of this size
+            hdr.msg_control = &batch.controls[i * CMSG_SPACE(sizeof(uint16_t))];
+            hdr.msg_controllen = CMSG_SPACE(sizeof(uint16_t));
+            auto cmsg = CMSG_FIRSTHDR(&hdr);
+            cmsg->cmsg_level = SOL_UDP;
+            cmsg->cmsg_type = UDP_SEGMENT;
+            cmsg->cmsg_len = CMSG_LEN(sizeof(uint16_t));
+            memcpy(CMSG_DATA(cmsg), &batch.segments[i], sizeof(uint16_t));
+        }
+    }
+
+    for (size_t sent = 0; sent < batch.msgs.size(); ) {
+        auto ret = sendmmsg(fd, &batch.msgs[sent], batch.msgs.size() - sent, 0);
+        if (ret < 0) {
+            // a datagram that cannot be sent is dropped, the rest of the batch still goes out
+            ret = 1;
+        }
+        sent += ret;
+    }
+
+    // clear() keeps the capacity, so a steady stream of batches does not allocate
+    batch.addrs.clear();
+    batch.iovs.clear();
+    batch.segments.clear();
+    batch.msgs.clear();
+}
+
+int socketReceiveBatch(int fd, ReceiveBatch &batch, bool wait) {
+    // the kernel shrinks msg_controllen to what it wrote, so it is reset before every call
+    for (auto i = 0; i < BATCH; ++i) {
+        batch.msgs[i].msg_hdr.msg_control = &batch.controls[i * CMSG_SPACE(sizeof(int))];
+        batch.msgs[i].msg_hdr.msg_controllen = CMSG_SPACE(sizeof(int));
+    }
+    batch.segments.clear();
+    auto count = recvmmsg(fd, batch.msgs.data(), BATCH, wait ? MSG_WAITFORONE : MSG_DONTWAIT, NULL);
+    if ((count < 0) && (!wait) && ((errno == EAGAIN) || (errno == EWOULDBLOCK))) {
+        count = 0;
+    } else if (count <= 0) {
+        std::cerr << "socket receive error" << std::endl;
         exit(0);
     }
 
-    return std::string(buf);;
+    for (auto i = 0; i < count; ++i) {
+        auto &hdr = batch.msgs[i].msg_hdr;
+        size_t len = batch.msgs[i].msg_len, segment = len;
+        for (auto cmsg = CMSG_FIRSTHDR(&hdr); cmsg != NULL; cmsg = CMSG_NXTHDR(&hdr, cmsg)) {
+            if ((cmsg->cmsg_level == SOL_UDP) && (cmsg->cmsg_type == UDP_GRO)) {
+                int size;
+                memcpy(&size, CMSG_DATA(cmsg), sizeof(int));
+                segment = (size > 0) ? size : len;
+            }
+        }
+        // a coalesced datagram holds segments of the same size, the last one may be shorter
+        for (size_t offset = 0; offset < len; offset += segment) {
+            batch.segments.push_back(std::make_pair(&batch.bufs[i * batch.slot + offset], std::min(segment, len - offset)));
+        }
+        if (len == 0) {
+            batch.segments.push_back(std::make_pair(&batch.bufs[i * batch.slot], static_cast<size_t>(0)));
+        }
+    }
+    batch.count = batch.segments.size();
+
+    return batch.count;
 }
@@ -4,16 +4,116 @@
 #include <arpa/inet.h>
 #include <sys/socket.h>
 #include <unistd.h>
+#include <cstdint>
 #include <cstring>
 #include <iostream>
 #include <string>
+#include <vector>
 
 const int BUFLEN = 2048;
 
+// largest datagram that fits an Ethernet MTU without fragmentation (1500 - IPv4 and UDP headers)
+const int SEGMENT_SIZE = 1472;
+
+// receive buffer of one datagram when GRO may coalesce several segments into it
+const int GRO_BUFLEN = 65536;
+
+// maximum number of segments sent with one UDP_SEGMENT datagram, within the 64 KB limit
+const int GSO_SEGMENTS = 44;
+
+// maximum number of datagrams received by one system call
+const int BATCH = 64;
+
+// kernel segmentation offloads available on a socket, see socketOffload
+enum { OFFLOAD_GSO = 1, OFFLOAD_GRO = 2 };
+
+// reusable buffers for a batch of received datagrams, a datagram coalesced by GRO is split back
+// into its segments so that data(i) and size(i) always give a single one
+class ReceiveBatch {
+public:
+    int count;
+
+    // slot is the largest datagram received, GRO_BUFLEN if GRO is enabled on the socket
+    ReceiveBatch(size_t slot = BUFLEN);
+
+    char *data(int i) { return segments[i].first; }
+    const char *data(int i) const { return segments[i].first; }
+    size_t size(int i) const { return segments[i].second; }
+
+    void clear() {
+        segments.clear();
+        count = 0;
+    }
+
+    // a message received by another transport, data must stay valid until the batch is reused
+    void add(char *data, size_t len) {
+        segments.push_back(std::make_pair(data, len));
+        count = segments.size();
+    }
+
+    friend int socketReceiveBatch(int fd, ReceiveBatch &batch, bool wait);
+
+private:
+    size_t slot;
+    std::vector<char> bufs;
+    // <start, length> of each segment, in bufs unless it came from another transport
+    std::vector<std::pair<char *, size_t> > segments;
+    std::vector<char> controls;
+    std::vector<struct iovec> iovs;
+    std::vector<struct mmsghdr> msgs;
+};
+
 int socketBind(int port);
 
+// listening Unix domain stream socket at path, replacing a stale one
+int socketListen(const std::string &path);
+
+// write all of str to a stream socket, false if the peer is gone
+bool socketWriteAll(int fd, const std::string &str);
+
+// enable GRO on a UDP socket and probe for GSO, return the OFFLOAD_* that are available
+int socketOffload(int fd);
+
 void socketSend(int fd, int port, const std::string &str);
 
 std::string socketReceive(int fd);
 
+// batch of datagrams to different destinations, sent with one system call
+class SendBatch {
+public:
+    // datagrams longer than a segment go out as one UDP_SEGMENT send per GSO_SEGMENTS segments,
+    // otherwise as one datagram per segment
+    bool gso;
+
+    SendBatch() : gso(false) {}
+
+    // data must stay valid until flush, with segment > 0 it is cut into datagrams of that size
+    // (the last one may be shorter)
+    void add(const struct sockaddr_in &addr, const char *data, size_t len, size_t segment = 0);
+    size_t size() const { return addrs.size(); }
+
+    friend void socketSendBatch(int fd, SendBatch &batch);
+
+private:
+    std::vector<struct sockaddr_in> addrs;
+    std::vector<struct iovec> iovs;
+    // UDP_SEGMENT size of each message, 0 for a plain datagram
+    std::vector<uint16_t> segments;
+    std::vector<char> controls;
+    std::vector<struct mmsghdr> msgs;
+};
+
+// loopback address of port
+struct sockaddr_in socketAddress(int port);
+
+// send str to all addresses through file descriptor fd with one system call
+void socketBroadcast(int fd, const std::vector<struct sockaddr_in> &addrs, const std::string &str);
+
+// send and clear every datagram in batch
+void socketSendBatch(int fd, SendBatch &batch);
+
+// block until a datagram arrives, then take every pending one (up to BATCH) with one system call;
+// without wait only what is pending is taken, possibly nothing
+int socketReceiveBatch(int fd, ReceiveBatch &batch, bool wait = true);
+
 #endif
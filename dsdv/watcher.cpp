@@ -0,0 +1,82 @@
+#include <sys/inotify.h>
+#include <poll.h>
+#include <unistd.h>
+#include <cstring>
+#include <iostream>
+#include "watcher.h"
+
+// polling interval of the fallback (in seconds)
+const double POLL_INTERVAL = 0.2;
+
+FileWatcher::FileWatcher(const std::string &filename) : filename(filename) {
+    auto slash = filename.rfind('/');
+    auto dir = (slash == std::string::npos) ? std::string(".") : filename.substr(0, slash + 1);
+    base = (slash == std::string::npos) ? filename : filename.substr(slash + 1);
+
+    memset(&last, 0, sizeof(struct stat));
+    stat(filename.c_str(), &last);
+
+    fd = inotify_init1(IN_CLOEXEC);
+    if ((fd >= 0) && (inotify_add_watch(fd, dir.c_str(), IN_CLOSE_WRITE | IN_MOVED_TO | IN_CREATE) < 0)) {
+        close(fd);
+        fd = -1;
+    }
+    if (fd < 0) {
+        std::cerr << "inotify unavailable, polling " << filename << std::endl;
+    }
+}
+
+FileWatcher::~FileWatcher() {
+    if (fd >= 0) {
+        close(fd);
+    }
+}
+
+bool FileWatcher::wait(double timeout) {
+    if (fd < 0) {
+        for (auto waited = 0.0; (timeout < 0) || (waited < timeout); waited += POLL_INTERVAL) {
+            if (statChanged()) {
+                return true;
+            }
+            usleep(POLL_INTERVAL * 1000000);
+        }
+        return statChanged();
+    }
+
+    struct pollfd pfd;
+    pfd.fd = fd;
+    pfd.events = POLLIN;
+    if (poll(&pfd, 1, (timeout < 0) ? -1 : static_cast<int>(timeout * 1000)) <= 0) {
+        return false;
+    }
+
+    // events of other files in the same directory are drained and ignored
+    char buf[4096] __attribute__ ((aligned(__alignof__(struct inotify_event))));
+    auto len = read(fd, buf, sizeof(buf));
+    bool ret = false;
+    for (auto p = buf; p < buf + len; ) {
+        auto event = reinterpret_cast<struct inotify_event *>(p);
+        if ((event->len > 0) && (base == event->name)) {
+            ret = true;
+        }
+        p += sizeof(struct inotify_event) + event->len;
+    }
+    if (ret) {
+        statChanged();
+    }
+
+    return ret;
+}
+
+bool FileWatcher::statChanged() {
+    struct stat now;
+    memset(&now, 0, sizeof(struct stat));
+    if (stat(filename.c_str(), &now) < 0) {
+        return false;
+    }
+
+    bool ret = (now.st_mtim.tv_sec != last.st_mtim.tv_sec) || (now.st_mtim.tv_nsec != last.st_mtim.tv_nsec) ||
+        (now.st_size != last.st_size) || (now.st_ino != last.st_ino);
+    last = now;
+    return ret;
+}
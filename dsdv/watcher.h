@@ -0,0 +1,27 @@
+#ifndef WATCHER_H_
+#define WATCHER_H_
+
+#include <sys/stat.h>
+#include <string>
+
+// watch a single file for changes, by inotify on its directory (so that editors replacing the
+// file are noticed too) or, if inotify is unavailable, by polling its modification time and size
+class FileWatcher {
+public:
+    FileWatcher(const std::string &filename);
+    ~FileWatcher();
+
+    // block until the file has been written or replaced, or timeout seconds passed (forever if negative),
+    // return true if the file may have changed
+    bool wait(double timeout);
+
+private:
+    std::string filename;
+    std::string base;
+    int fd;
+    struct stat last;
+
+    bool statChanged();
+};
+
+#endif
@@ -0,0 +1,305 @@
+/*
+ * FILE: rdt_proxy.cc
+ * DESCRIPTION: A UDP relay between the two ends of rdt_udp that impairs the
+ *       link the way rdt_sim does: a packet is lost, corrupted in every byte
+ *       or delivered out of order with the same probabilities, and held for
+ *       the same latency.  Runs until interrupted, then prints what it did.
+ */
+
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <signal.h>
+#include <time.h>
+#include <unistd.h>
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <sys/epoll.h>
+#include <sys/socket.h>
+#include <sys/timerfd.h>
+
+#include <queue>
+#include <string>
+#include <vector>
+
+#include "rdt_struct.h"
+
+
+/*[]------------------------------------------------------------------------[]
+  |  gloabal variables, statistics, etc.
+  []------------------------------------------------------------------------[]*/
+
+/* one-way latency every packet is held for (in seconds), 0 relays at once */
+double pkt_latency;
+
+/* the probability that a packet is held for a random time up to twice the
+   latency instead, which needs a latency to reorder anything */
+double outoforder_rate;
+
+/* packet loss probability */
+double loss_rate;
+
+/* packet corruption probability, of the packets not lost */
+double corrupt_rate;
+
+/* the two ends, a packet from one is relayed to the other */
+struct sockaddr_in sender_addr, receiver_addr;
+
+/* a packet waiting for its delivery time */
+struct Held {
+    double due;
+    long order;                 /* keeps packets due at once in order */
+    bool to_receiver;
+    std::string data;
+
+    bool operator<(const Held &other) const {
+	if (due!=other.due) return due>other.due;
+	return order>other.order;
+    }
+};
+
+std::priority_queue<Held> held;
+
+/* general statistics */
+long tot_pkts_relayed = 0;
+long tot_pkts_lost = 0;
+long tot_pkts_corrupted = 0;
+long tot_pkts_reordered = 0;
+
+volatile sig_atomic_t stopped = 0;
+
+
+/*[]------------------------------------------------------------------------[]
+  |  relay routines
+  []------------------------------------------------------------------------[]*/
+
+/* generate a random number in [0,1] */
+static double myrandom()
+{
+    return(rand()*1.0/RAND_MAX);
+}
+
+static double now()
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec/1e9;
+}
+
+static void stop(int)
+{
+    stopped = 1;
+}
+
+static bool parse_port(const char *str, struct sockaddr_in *addr)
+{
+    int port = atoi(str);
+    if (port<=0 || port>65535) return false;
+    memset(addr, 0, sizeof(*addr));
+    addr->sin_family = AF_INET;
+    addr->sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    addr->sin_port = htons(port);
+    return true;
+}
+
+static void deliver(int sock, const Held &pkt)
+{
+    const struct sockaddr_in *to = pkt.to_receiver ? &receiver_addr : &sender_addr;
+    if (sendto(sock, pkt.data.data(), pkt.data.size(), 0, (const struct sockaddr*)to,
+	       sizeof(*to))==(ssize_t)pkt.data.size())
+	tot_pkts_relayed ++;
+}
+
+/* arm the timer for the first held packet */
+static void arm(int timer)
+{
+    struct itimerspec spec;
+    memset(&spec, 0, sizeof(spec));
+    if (!held.empty()) {
+	double timeout = held.top().due - now();
+	if (timeout<1e-9) timeout = 1e-9;
+	spec.it_value.tv_sec = (time_t)timeout;
+	spec.it_value.tv_nsec = (long)((timeout-spec.it_value.tv_sec)*1e9);
+	if (spec.it_value.tv_sec==0 && spec.it_value.tv_nsec==0)
+	    spec.it_value.tv_nsec = 1;
+    }
+    timerfd_settime(timer, 0, &spec, NULL);
+}
+
+/* impair a packet and relay or hold it, same as Sender_ToLowerLayer() and
+   Receiver_ToLowerLayer() in rdt_sim.cc */
+static void relay(int sock, Held &pkt)
+{
+    /* packet lost at rate "loss_rate" */
+    if (myrandom()<loss_rate) {
+	tot_pkts_lost ++;
+	return;
+    }
+
+    /* packet corrupted at rate "corrupt_rate" */
+    if (myrandom()<corrupt_rate) {
+	for (size_t i=0; i<pkt.data.size(); i++) {
+	    pkt.data[i] = pkt.data[i] + (char)(myrandom()*20) - 10;
+	}
+	tot_pkts_corrupted ++;
+    }
+
+    /* hold the packet until its arrival time at the other side */
+    double delay = pkt_latency;
+    if (myrandom()<outoforder_rate) {
+	delay = pkt_latency*2.0*myrandom();
+	tot_pkts_reordered ++;
+    }
+    if (delay<=0 && held.empty()) {
+	deliver(sock, pkt);
+	return;
+    }
+    static long order = 0;
+    pkt.due = now() + delay;
+    pkt.order = order++;
+    held.push(pkt);
+}
+
+
+/*[]------------------------------------------------------------------------[]
+  |  main control routine
+  []------------------------------------------------------------------------[]*/
+
+int main(int argc, char *argv[])
+{
+    if (argc!=8) {
+	fprintf(stderr, "usage: %s <port> <sender_port> <receiver_port> <latency> "
+		"<outoforder_rate> <loss_rate> <corrupt_rate>\n", argv[0]);
+	exit(-1);
+    }
+
+    struct sockaddr_in local;
+    if (!parse_port(argv[1], &local)) {
+	fprintf(stderr, "invalid <port>\n");
+	exit(-1);
+    }
+    local.sin_addr.s_addr = htonl(INADDR_ANY);
+    if (!parse_port(argv[2], &sender_addr)) {
+	fprintf(stderr, "invalid <sender_port>\n");
+	exit(-1);
+    }
+    if (!parse_port(argv[3], &receiver_addr)) {
+	fprintf(stderr, "invalid <receiver_port>\n");
+	exit(-1);
+    }
+    pkt_latency = atof(argv[4]);
+    if (pkt_latency<0) {
+	fprintf(stderr, "invalid <latency>\n");
+	exit(-1);
+    }
+    outoforder_rate = atof(argv[5]);
+    if (outoforder_rate<0 || outoforder_rate>1) {
+	fprintf(stderr, "invalid <outoforder_rate>\n");
+	exit(-1);
+    }
+    loss_rate = atof(argv[6]);
+    if (loss_rate<0 || loss_rate>1) {
+	fprintf(stderr, "invalid <loss_rate>\n");
+	exit(-1);
+    }
+    corrupt_rate = atof(argv[7]);
+    if (corrupt_rate<0 || corrupt_rate>1) {
+	fprintf(stderr, "invalid <corrupt_rate>\n");
+	exit(-1);
+    }
+
+    int sock = socket(AF_INET, SOCK_DGRAM | SOCK_NONBLOCK, 0);
+    if (sock<0 || bind(sock, (struct sockaddr*)&local, sizeof(local))<0) {
+	perror("socket");
+	exit(-1);
+    }
+    int timer = timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK);
+    int ep = epoll_create1(0);
+    if (timer<0 || ep<0) {
+	perror("epoll");
+	exit(-1);
+    }
+    int fds[2] = {sock, timer};
+    for (int i=0; i<2; i++) {
+	struct epoll_event ev;
+	ev.events = EPOLLIN;
+	ev.data.fd = fds[i];
+	if (epoll_ctl(ep, EPOLL_CTL_ADD, fds[i], &ev)<0) {
+	    perror("epoll_ctl");
+	    exit(-1);
+	}
+    }
+
+    signal(SIGINT, stop);
+    signal(SIGTERM, stop);
+    srand(getpid()+getppid());
+
+    fprintf(stdout, "## Relaying on port %s between %s and %s with\n"
+	    "\tlatency is %.3f seconds\n"
+	    "\taverage out-of-order delivery rate is %.2f%%\n"
+	    "\taverage loss rate is %.2f%%\n"
+	    "\taverage corrupt rate is %.2f%%\n",
+	    argv[1], argv[2], argv[3], pkt_latency, outoforder_rate*100.0,
+	    loss_rate*100.0, corrupt_rate*100.0);
+    fflush(stdout);
+
+    /* main relay loop */
+    struct epoll_event events[2];
+    Held pkt;
+    char buf[RDT_MAXPKTSIZE];
+    while (!stopped) {
+	int n = epoll_wait(ep, events, 2, -1);
+	if (n<0) {
+	    if (errno==EINTR) continue;
+	    perror("epoll_wait");
+	    exit(-1);
+	}
+
+	for (int i=0; i<n; i++) {
+	    if (events[i].data.fd==sock) {
+		for (;;) {
+		    struct sockaddr_in from;
+		    socklen_t fromlen = sizeof(from);
+		    ssize_t len = recvfrom(sock, buf, RDT_MAXPKTSIZE, 0,
+					   (struct sockaddr*)&from, &fromlen);
+		    if (len<0) break;
+		    /* anything not from one of the two ends is dropped */
+		    if (from.sin_port==sender_addr.sin_port)
+			pkt.to_receiver = true;
+		    else if (from.sin_port==receiver_addr.sin_port)
+			pkt.to_receiver = false;
+		    else
+			continue;
+		    pkt.data.assign(buf, len);
+		    relay(sock, pkt);
+		}
+	    } else {
+		uint64_t expirations;
+		if (read(timer, &expirations, sizeof(expirations))<0) continue;
+	    }
+	}
+
+	/* release everything that is due, then wait for the next one */
+	double t = now();
+	while (!held.empty() && held.top().due<=t) {
+	    deliver(sock, held.top());
+	    held.pop();
+	}
+	arm(timer);
+    }
+
+    fprintf(stdout, "\n");
+    fprintf(stdout, "## Relay stopped with\n"
+	    "\t%ld packets relayed\n"
+	    "\t%ld packets lost\n"
+	    "\t%ld packets corrupted\n"
+	    "\t%ld packets out of order\n",
+	    tot_pkts_relayed, tot_pkts_lost, tot_pkts_corrupted, tot_pkts_reordered);
+
+    close(ep);
+    close(timer);
+    close(sock);
+    return 0;
+}
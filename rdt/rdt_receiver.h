@@ -18,6 +18,22 @@
 /* get simulation time (in seconds) */
 double GetSimulationTime();
 
+/* get the largest packet the lower layer carries (in bytes) */
+int GetPacketSize();
+
+/* start the receiver timer with a specified timeout (in seconds).
+   the timer is canceled with Receiver_StopTimer() is called or a new
+   Receiver_StartTimer() is called before the current timer expires.
+   Receiver_Timeout() will be called when the timer expires. */
+void Receiver_StartTimer(double timeout);
+
+/* stop the receiver timer */
+void Receiver_StopTimer();
+
+/* check whether the receiver timer is being set,
+   return true if the timer is set, return false otherwise */
+bool Receiver_isTimerSet();
+
 /* pass a packet to the lower layer at the receiver */
 void Receiver_ToLowerLayer(struct packet *pkt);
 
@@ -43,4 +59,7 @@ void Receiver_Final();
    receiver */
 void Receiver_FromLowerLayer(struct packet *pkt);
 
+/* event handler, called when the timer expires */
+void Receiver_Timeout();
+
 #endif  /* _RDT_RECEIVER_H_ */
@@ -18,6 +18,9 @@
 /* get simulation time (in seconds) */
 double GetSimulationTime();
 
+/* get the largest packet the lower layer carries (in bytes) */
+int GetPacketSize();
+
 /* start the sender timer with a specified timeout (in seconds).
    the timer is canceled with Sender_StopTimer() is called or a new 
    Sender_StartTimer() is called before the current timer expires.
@@ -91,7 +91,8 @@ public:
   []------------------------------------------------------------------------[]*/
 
 enum {EVENT_SENDER_FROMUPPERLAYER=0, EVENT_SENDER_FROMLOWERLAYER, 
-      EVENT_SENDER_TIMEOUT, EVENT_RECEIVER_FROMLOWERLAYER};
+      EVENT_SENDER_TIMEOUT, EVENT_RECEIVER_FROMLOWERLAYER,
+      EVENT_RECEIVER_TIMEOUT};
 
 /* the event that the upper layer at the sender instructs rdt layer to send out 
    a message */
@@ -109,6 +110,7 @@ public:
     struct packet pkt;
 public:
     EventSenderFromLowerLayer() { event_type = EVENT_SENDER_FROMLOWERLAYER; }
+    ~EventSenderFromLowerLayer() { free(pkt.data); }
 };
 
 /* the event that the timer at the sender expires */
@@ -126,6 +128,14 @@ public:
     struct packet pkt;
 public:
     EventReceiverFromLowerLayer() { event_type = EVENT_RECEIVER_FROMLOWERLAYER; }
+    ~EventReceiverFromLowerLayer() { free(pkt.data); }
+};
+
+/* the event that the timer at the receiver expires */
+class EventReceiverTimeout : public Event
+{
+public:
+    EventReceiverTimeout() { event_type = EVENT_RECEIVER_TIMEOUT; }
 };
 
 
@@ -146,6 +156,19 @@ int msg_size;
 /* average one-way packet delivery latency, set to be 100ms */
 const double pkt_latency = 0.1;
 
+/* largest packet passed to the lower layer (in bytes), RDT_PKTSIZE unless
+   given */
+int pkt_size = RDT_PKTSIZE;
+
+/* link rate (in bytes per second): a packet is delivered only after all of
+   its bytes, and those of the packets before it in the same direction, went
+   onto the link */
+double link_rate = 1000000;
+
+/* time the link in each direction, to the receiver and to the sender, has
+   serialized every packet passed to it */
+double link_busy[2] = {0, 0};
+
 /* the probability that a packet is not delivered with the normal latency:
    a value of 0.1 means that one in ten packets are not delivered with the 
    normal latency */
@@ -173,10 +196,15 @@ EventChain sim_core;
 /* sender timer event */
 Event *sender_timer = NULL;
 
+/* receiver timer event */
+Event *receiver_timer = NULL;
+
 /* general statistics */
 int tot_chars_sent = 0;
 int tot_chars_delivered = 0;
 int tot_pkts_passed = 0;
+long tot_bytes_passed = 0;
+int tot_events = 0;
 
 /* error flag set by message verification at the receiver */
 bool message_verfication_passed = true;
@@ -225,6 +253,22 @@ static void free_msg(struct message *msg)
     if (msg!=NULL) free(msg);
 }
 
+/* get the largest packet (in bytes) - for both the sender and the receiver */
+int GetPacketSize()
+{
+    return pkt_size;
+}
+
+/* put a packet of size bytes onto the link in direction dir after those
+   before it, return the time its last byte is sent */
+static double serialize(int dir, int size)
+{
+    double start = (link_busy[dir]>sim_core.time()) ? link_busy[dir] : sim_core.time();
+    link_busy[dir] = start + size/link_rate;
+    tot_bytes_passed += size;
+    return link_busy[dir];
+}
+
 /* get simulation time (in seconds) - for both the sender and the receiver */
 double GetSimulationTime()
 {
@@ -275,27 +319,77 @@ bool Sender_isTimerSet()
     return (sender_timer!=NULL);
 }
 
+/* start the receiver timer with a specified timeout (in seconds), same as
+   the sender timer */
+void Receiver_StartTimer(double timeout)
+{
+    if (tracing_level>=1)
+	fprintf(stdout, "Time %.2fs (Receiver): the timer is started (expires at %.2fs).\n",
+		sim_core.time(), sim_core.time() + timeout);
+
+    if (receiver_timer!=NULL) {
+	sim_core.cancel(receiver_timer);
+	delete receiver_timer;
+	receiver_timer = NULL;
+    }
+
+    EventReceiverTimeout *e = new EventReceiverTimeout;
+    e->sched_time = sim_core.time() + timeout;
+    sim_core.schedule(e);
+
+    receiver_timer = e;
+}
+
+/* stop the receiver timer */
+void Receiver_StopTimer()
+{
+    if (tracing_level>=1)
+	fprintf(stdout, "Time %.2fs (Receiver): the timer is stopped.\n",
+		sim_core.time());
+
+    if (receiver_timer!=NULL) {
+	sim_core.cancel(receiver_timer);
+	delete receiver_timer;
+	receiver_timer = NULL;
+    }
+}
+
+/* check whether the receiver timer is being set,
+   return true if the timer is set, return false otherwise */
+bool Receiver_isTimerSet()
+{
+    return (receiver_timer!=NULL);
+}
+
 /* pass a packet to the lower layer at the sender */
 void Sender_ToLowerLayer(struct packet *pkt)
 {
+    ASSERT(pkt->size>0 && pkt->size<=RDT_MAXPKTSIZE);
+
+    /* a lost packet takes its time on the link too */
+    double sent = serialize(0, pkt->size);
+
     /* packet lost at rate "loss_rate" */
     if (myrandom()<loss_rate) return;
 
     EventReceiverFromLowerLayer *e = new EventReceiverFromLowerLayer;
-    memcpy(&e->pkt.data, pkt->data, RDT_PKTSIZE);
+    e->pkt.size = pkt->size;
+    e->pkt.data = (char*) malloc(pkt->size);
+    ASSERT(e->pkt.data!=NULL);
+    memcpy(e->pkt.data, pkt->data, pkt->size);
 
     /* packet corrupted at rate "corrupt_rate" */
     if (myrandom()<corrupt_rate) {
-	for (int i=0; i<RDT_PKTSIZE; i++) {
+	for (int i=0; i<e->pkt.size; i++) {
 	    e->pkt.data[i] = e->pkt.data[i] + (char)(myrandom()*20) - 10;
 	}
     }
 
     /* schedule the packet arrival event at the other side */
     if (myrandom()<outoforder_rate)
-	e->sched_time = sim_core.time() + pkt_latency*2.0*myrandom();
+	e->sched_time = sent + pkt_latency*2.0*myrandom();
     else
-	e->sched_time = sim_core.time() + pkt_latency;
+	e->sched_time = sent + pkt_latency;
     sim_core.schedule(e);
 
     tot_pkts_passed ++;
@@ -305,24 +399,32 @@ void Sender_ToLowerLayer(struct packet *pkt)
 /* pass a packet to the lower layer at the receiver */
 void Receiver_ToLowerLayer(struct packet *pkt)
 {
+    ASSERT(pkt->size>0 && pkt->size<=RDT_MAXPKTSIZE);
+
+    /* a lost packet takes its time on the link too */
+    double sent = serialize(1, pkt->size);
+
     /* packet lost at rate "loss_rate" */
     if (myrandom()<loss_rate) return;
 
     EventSenderFromLowerLayer *e = new EventSenderFromLowerLayer;
-    memcpy(&e->pkt.data, pkt->data, RDT_PKTSIZE);
+    e->pkt.size = pkt->size;
+    e->pkt.data = (char*) malloc(pkt->size);
+    ASSERT(e->pkt.data!=NULL);
+    memcpy(e->pkt.data, pkt->data, pkt->size);
 
     /* packet corrupted at rate "corrupt_rate" */
     if (myrandom()<corrupt_rate) {
-	for (int i=0; i<RDT_PKTSIZE; i++) {
+	for (int i=0; i<e->pkt.size; i++) {
 	    e->pkt.data[i] = e->pkt.data[i] + (char)(myrandom()*20) - 10;
 	}
     }
 
     /* schedule the packet arrival event at the other side */
     if (myrandom()<outoforder_rate)
-	e->sched_time = sim_core.time() + pkt_latency*2.0*myrandom();
+	e->sched_time = sent + pkt_latency*2.0*myrandom();
     else
-	e->sched_time = sim_core.time() + pkt_latency;	
+	e->sched_time = sent + pkt_latency;
     sim_core.schedule(e);
 
     tot_pkts_passed ++;
@@ -364,9 +466,10 @@ void Receiver_ToUpperLayer(struct message *msg)
 
 int main(int argc, char *argv[])
 {
-    if (argc!=8) {
+    if (argc<8 || argc>10) {
 	fprintf(stderr, "usage: %s <sim_time> <mean_msg_arrivalint> <mean_msg_size> "
-		"<outoforder_rate> <loss_rate> <corrupt_rate> <tracing_level>\n", 
+		"<outoforder_rate> <loss_rate> <corrupt_rate> <tracing_level> "
+		"[<packet_size> [<link_rate>]]\n", 
 		argv[0]);
 	exit(-1);
     }
@@ -406,6 +509,21 @@ int main(int argc, char *argv[])
 	fprintf(stderr, "invalid <tracing_level>\n");
 	exit(-1);
     }
+    /* room for the header and an ACK that NAKs a whole window */
+    if (argc>8) {
+	pkt_size = atoi(argv[8]);
+	if (pkt_size<32 || pkt_size>RDT_MAXPKTSIZE) {
+	    fprintf(stderr, "invalid <packet_size>, from 32 to %d\n", RDT_MAXPKTSIZE);
+	    exit(-1);
+	}
+    }
+    if (argc>9) {
+	link_rate = atof(argv[9]);
+	if (link_rate<=0) {
+	    fprintf(stderr, "invalid <link_rate>\n");
+	    exit(-1);
+	}
+    }
     
     fprintf(stdout, "## Reliable data transfer simulation with:\n"
 	    "\tsimulation time is %.3f seconds\n"
@@ -415,9 +533,12 @@ int main(int argc, char *argv[])
 	    "\taverage loss rate is %.2f%%\n"
 	    "\taverage corrupt rate is %.2f%%\n"
 	    "\ttracing level is %d\n"
+	    "\tpacket size is %d bytes\n"
+	    "\tlink rate is %.0f bytes per second\n"
 	    "Please review these inputs and press <enter> to proceed.\n",
 	    sim_time, msg_arrivalint, msg_size, outoforder_rate*100.0, 
-	    loss_rate*100.0, corrupt_rate*100.0, tracing_level);
+	    loss_rate*100.0, corrupt_rate*100.0, tracing_level, pkt_size,
+	    link_rate);
     fgetc(stdin);
 
     /* initialize the random number generator */
@@ -449,6 +570,7 @@ int main(int argc, char *argv[])
     for (;;) {
 	Event *e = sim_core.next_event();
 	if (e==NULL) break;
+	tot_events ++;
 
 	switch (e->event_type) {
 	case EVENT_SENDER_FROMUPPERLAYER:
@@ -516,6 +638,20 @@ int main(int argc, char *argv[])
 	    }
 	    break;
 
+	case EVENT_RECEIVER_TIMEOUT:
+	    {
+		if (tracing_level>=1) {
+		    fprintf(stdout, "Time %.2fs (Receiver): the timer expires.\n", sim_core.time());
+		}
+
+		EventReceiverTimeout *real_e = (EventReceiverTimeout*) e;
+		delete real_e;
+		receiver_timer = NULL;
+
+		Receiver_Timeout();
+	    }
+	    break;
+
 	default:
 	    fprintf(stderr, "undefined event %d\n", e->event_type);
 	    break;
@@ -530,8 +666,11 @@ int main(int argc, char *argv[])
     fprintf(stdout, "## Simulation completed at time %.2fs with\n" 
 	    "\t%d characters sent\n" 
 	    "\t%d characters delivered\n"
-	    "\t%d packets passed between the sender and the receiver\n", 
-	    sim_core.time(), tot_chars_sent, tot_chars_delivered, tot_pkts_passed);
+	    "\t%d packets passed between the sender and the receiver\n"
+	    "\t%ld bytes passed between the sender and the receiver\n"
+	    "\t%d events simulated\n",
+	    sim_core.time(), tot_chars_sent, tot_chars_delivered, tot_pkts_passed,
+	    tot_bytes_passed, tot_events);
 
     if (message_verfication_passed && (tot_chars_sent==tot_chars_delivered))
 	fprintf(stdout, "## Congratulations! This session is error-free, loss-free, and in order.\n");
@@ -22,12 +22,16 @@ struct message {
     char *data;
 };
 
-/* a packet is a data unit passed between rdt layer and the lower layer, each 
-   packet has a fixed size */
+/* a packet is a data unit passed between rdt layer and the lower layer, of
+   size bytes: at most the packet size of the run, see GetPacketSize(), which
+   is RDT_PKTSIZE unless given otherwise and never above RDT_MAXPKTSIZE.
+   data belongs to whoever passes the packet, the lower layer copies it */
 #define RDT_PKTSIZE 128
+#define RDT_MAXPKTSIZE 9000
 
 struct packet {
-    char data[RDT_PKTSIZE];
+    int size;
+    char *data;
 };
 
 #endif  /* _RDT_STRUCT_H_ */
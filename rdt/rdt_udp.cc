@@ -0,0 +1,467 @@
+/*
+ * FILE: rdt_udp.cc
+ * DESCRIPTION: Runs the reliable data transfer sender or receiver over a real
+ *       UDP socket instead of the simulated link.  The routines of
+ *       rdt_sender.h and rdt_receiver.h are implemented with a non-blocking
+ *       socket, an epoll loop and a timerfd for the sender timer, so the same
+ *       rdt_sender.o and rdt_receiver.o can be measured on a real network
+ *       stack.  Put rdt_proxy between the two ends to impair the link.
+ */
+
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <time.h>
+#include <unistd.h>
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <sys/epoll.h>
+#include <sys/resource.h>
+#include <sys/socket.h>
+#include <sys/timerfd.h>
+
+#include "rdt_struct.h"
+#include "rdt_sender.h"
+#include "rdt_receiver.h"
+
+
+/*[]------------------------------------------------------------------------[]
+  |  gloabal variables, statistics, etc.
+  []------------------------------------------------------------------------[]*/
+
+/* seconds the receiver keeps acknowledging retransmissions after the last
+   byte was delivered, the sender has stopped once it hears nothing for that
+   long */
+const double linger = 1.0;
+
+/* the socket both ends send on, and the address of the other end (or of the
+   proxy in between) */
+int sock = -1;
+struct sockaddr_in peer;
+
+/* the timer of whichever end this process runs */
+int timer = -1;
+bool timer_set = false;
+
+/* start of the run, GetSimulationTime() counts from here */
+struct timespec start;
+
+/* bytes the sender passes to the rdt layer, and the receiver waits for */
+long total_bytes;
+
+/* average size of messages (in bytes) */
+int msg_size;
+
+/* largest packet passed to the socket (in bytes), RDT_PKTSIZE unless given */
+int pkt_size = RDT_PKTSIZE;
+
+/* average intervals between consecutive messages passed from the upper layer
+   at the sender (in seconds), 0 passes all of them at once */
+double msg_arrivalint;
+
+/* general statistics */
+long tot_chars_sent = 0;
+long tot_chars_delivered = 0;
+long tot_pkts_sent = 0;
+long tot_pkts_received = 0;
+
+/* error flag set by message verification at the receiver */
+bool message_verfication_passed = true;
+
+
+/*[]------------------------------------------------------------------------[]
+  |  runtime routines
+  []------------------------------------------------------------------------[]*/
+
+/* generate a random number in [0,1] */
+static double myrandom()
+{
+    return(rand()*1.0/RAND_MAX);
+}
+
+/* parse "port" or "address:port", the address defaults to the loopback */
+static bool parse_addr(const char *str, struct sockaddr_in *addr)
+{
+    memset(addr, 0, sizeof(*addr));
+    addr->sin_family = AF_INET;
+    addr->sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+
+    const char *colon = strchr(str, ':');
+    if (colon!=NULL) {
+	char host[64];
+	if (colon-str>=(int)sizeof(host)) return false;
+	memcpy(host, str, colon-str);
+	host[colon-str] = '\0';
+	if (inet_aton(host, &addr->sin_addr)==0) return false;
+	str = colon+1;
+    }
+
+    int port = atoi(str);
+    if (port<=0 || port>65535) return false;
+    addr->sin_port = htons(port);
+    return true;
+}
+
+/* generate a message, the same stream of digits as rdt_sim */
+static struct message *generate_msg()
+{
+    static char cnt = 0;
+
+    struct message *msg = (struct message*) malloc(sizeof(struct message));
+    ASSERT(msg!=NULL);
+    msg->size = (int)(myrandom()*2.0*msg_size);
+    if (msg->size==0) msg->size=1;
+    /* the last message ends exactly at total_bytes */
+    if (msg->size>total_bytes-tot_chars_sent) msg->size=total_bytes-tot_chars_sent;
+    msg->data = (char*) malloc(msg->size);
+    ASSERT(msg->data!=NULL);
+
+    for (int i=0; i<msg->size; i+=1) {
+	msg->data[i] = '0' + cnt;
+	cnt = (cnt+1) % 10;
+    }
+
+    tot_chars_sent += msg->size;
+
+    return msg;
+}
+
+/* free the space of a message */
+static void free_msg(struct message *msg)
+{
+    if (msg->data!=NULL) free(msg->data);
+    if (msg!=NULL) free(msg);
+}
+
+/* arm a timerfd to expire once after timeout seconds, 0 disarms it */
+static void arm(int fd, double timeout)
+{
+    struct itimerspec spec;
+    memset(&spec, 0, sizeof(spec));
+    if (timeout>0) {
+	spec.it_value.tv_sec = (time_t)timeout;
+	spec.it_value.tv_nsec = (long)((timeout-spec.it_value.tv_sec)*1e9);
+	/* a zero it_value disarms, so expire at once instead */
+	if (spec.it_value.tv_sec==0 && spec.it_value.tv_nsec==0)
+	    spec.it_value.tv_nsec = 1;
+    }
+    if (timerfd_settime(fd, 0, &spec, NULL)<0) {
+	perror("timerfd_settime");
+	exit(-1);
+    }
+}
+
+/* pass a packet to the socket, a full socket buffer loses it like the link
+   would */
+static void transmit(struct packet *pkt)
+{
+    if (sendto(sock, pkt->data, pkt->size, 0, (struct sockaddr*)&peer,
+	       sizeof(peer))==pkt->size)
+	tot_pkts_sent ++;
+}
+
+/* user and system CPU seconds of the process */
+static double cpu_time()
+{
+    struct rusage usage;
+    getrusage(RUSAGE_SELF, &usage);
+    return usage.ru_utime.tv_sec + usage.ru_utime.tv_usec/1e6 +
+	usage.ru_stime.tv_sec + usage.ru_stime.tv_usec/1e6;
+}
+
+/* get the time since the start of the run (in seconds) - for both the sender
+   and the receiver */
+double GetSimulationTime()
+{
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (now.tv_sec-start.tv_sec) + (now.tv_nsec-start.tv_nsec)/1e9;
+}
+
+/* start the sender timer with a specified timeout (in seconds).
+   re-arming a timerfd also discards an expiration that was not read yet, so
+   a timer restarted while its old expiration is pending does not fire. */
+void Sender_StartTimer(double timeout)
+{
+    arm(timer, timeout);
+    timer_set = true;
+}
+
+/* stop the sender timer */
+void Sender_StopTimer()
+{
+    arm(timer, 0);
+    timer_set = false;
+}
+
+/* check whether the sender timer is being set,
+   return true if the timer is set, return false otherwise */
+bool Sender_isTimerSet()
+{
+    return timer_set;
+}
+
+/* start the receiver timer, the same timerfd as the sender's since a process
+   runs only one of them */
+void Receiver_StartTimer(double timeout)
+{
+    arm(timer, timeout);
+    timer_set = true;
+}
+
+/* stop the receiver timer */
+void Receiver_StopTimer()
+{
+    arm(timer, 0);
+    timer_set = false;
+}
+
+/* check whether the receiver timer is being set */
+bool Receiver_isTimerSet()
+{
+    return timer_set;
+}
+
+/* get the largest packet (in bytes) - for both the sender and the receiver */
+int GetPacketSize()
+{
+    return pkt_size;
+}
+
+/* pass a packet to the lower layer at the sender */
+void Sender_ToLowerLayer(struct packet *pkt)
+{
+    transmit(pkt);
+}
+
+/* pass a packet to the lower layer at the receiver */
+void Receiver_ToLowerLayer(struct packet *pkt)
+{
+    transmit(pkt);
+}
+
+/* deliver a message to the upper layer at the receiver */
+void Receiver_ToUpperLayer(struct message *msg)
+{
+    static char cnt = 0;
+
+    for (int i=0; i<msg->size; i++) {
+	/* message verification */
+	if (msg->data[i] != '0' + cnt)
+	    message_verfication_passed = false;
+	cnt = (cnt+1) % 10;
+    }
+
+    tot_chars_delivered += msg->size;
+}
+
+
+/*[]------------------------------------------------------------------------[]
+  |  main control routine
+  []------------------------------------------------------------------------[]*/
+
+static void usage(const char *prog)
+{
+    fprintf(stderr, "usage: %s send <local_port> <peer> <total_bytes> "
+	    "<mean_msg_size> <mean_msg_arrivalint> [<packet_size>]\n"
+	    "       %s recv <local_port> <peer> <total_bytes>\n"
+	    "  <peer> is a port on the loopback or address:port\n",
+	    prog, prog);
+    exit(-1);
+}
+
+int main(int argc, char *argv[])
+{
+    if (argc<5) usage(argv[0]);
+
+    bool sender = (strcmp(argv[1], "send")==0);
+    if (sender) {
+	if (argc!=7 && argc!=8) usage(argv[0]);
+    } else if (strcmp(argv[1], "recv")==0) {
+	if (argc!=5) usage(argv[0]);
+    } else {
+	usage(argv[0]);
+    }
+
+    struct sockaddr_in local;
+    if (!parse_addr(argv[2], &local)) {
+	fprintf(stderr, "invalid <local_port>\n");
+	exit(-1);
+    }
+    local.sin_addr.s_addr = htonl(INADDR_ANY);
+    if (!parse_addr(argv[3], &peer)) {
+	fprintf(stderr, "invalid <peer>\n");
+	exit(-1);
+    }
+    total_bytes = atol(argv[4]);
+    if (total_bytes<=0) {
+	fprintf(stderr, "invalid <total_bytes>\n");
+	exit(-1);
+    }
+    if (sender) {
+	msg_size = atoi(argv[5]);
+	if (msg_size<=0) {
+	    fprintf(stderr, "invalid <msg_size>\n");
+	    exit(-1);
+	}
+	msg_arrivalint = atof(argv[6]);
+	if (msg_arrivalint<0) {
+	    fprintf(stderr, "invalid <msg_arrivalint>\n");
+	    exit(-1);
+	}
+	/* the receiver takes packets of any size, so only the sender is told */
+	if (argc==8) {
+	    pkt_size = atoi(argv[7]);
+	    if (pkt_size<32 || pkt_size>RDT_MAXPKTSIZE) {
+		fprintf(stderr, "invalid <packet_size>, from 32 to %d\n", RDT_MAXPKTSIZE);
+		exit(-1);
+	    }
+	}
+    }
+
+    sock = socket(AF_INET, SOCK_DGRAM | SOCK_NONBLOCK, 0);
+    if (sock<0 || bind(sock, (struct sockaddr*)&local, sizeof(local))<0) {
+	perror("socket");
+	exit(-1);
+    }
+    timer = timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK);
+    int arrival = timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK);
+    int ep = epoll_create1(0);
+    if (timer<0 || arrival<0 || ep<0) {
+	perror("epoll");
+	exit(-1);
+    }
+    int fds[3] = {sock, timer, arrival};
+    for (int i=0; i<3; i++) {
+	struct epoll_event ev;
+	ev.events = EPOLLIN;
+	ev.data.fd = fds[i];
+	if (epoll_ctl(ep, EPOLL_CTL_ADD, fds[i], &ev)<0) {
+	    perror("epoll_ctl");
+	    exit(-1);
+	}
+    }
+
+    srand(getpid()+getppid());
+    clock_gettime(CLOCK_MONOTONIC, &start);
+
+    if (sender) {
+	Sender_Init();
+	if (msg_arrivalint==0) {
+	    /* everything is queued at once, the window alone paces the link */
+	    while (tot_chars_sent<total_bytes) {
+		struct message *msg = generate_msg();
+		Sender_FromUpperLayer(msg);
+		free_msg(msg);
+	    }
+	} else {
+	    struct message *msg = generate_msg();
+	    Sender_FromUpperLayer(msg);
+	    free_msg(msg);
+	    if (tot_chars_sent<total_bytes)
+		arm(arrival, msg_arrivalint*2.0*myrandom());
+	}
+    } else {
+	Receiver_Init();
+    }
+
+    /* the receiver measures from its first packet, the sender from its
+       start */
+    double first = sender ? 0 : -1;
+    double finish = -1;
+    double last_heard = 0;
+
+    /* main event loop */
+    struct epoll_event events[3];
+    char buf[RDT_MAXPKTSIZE];
+    struct packet pkt;
+    pkt.data = buf;
+    for (;;) {
+	int n = epoll_wait(ep, events, 3, 100);
+	if (n<0) {
+	    if (errno==EINTR) continue;
+	    perror("epoll_wait");
+	    exit(-1);
+	}
+
+	for (int i=0; i<n; i++) {
+	    int fd = events[i].data.fd;
+	    if (fd==sock) {
+		/* drain the socket, one wakeup for every datagram pending */
+		for (;;) {
+		    ssize_t len = recv(sock, buf, RDT_MAXPKTSIZE, 0);
+		    if (len<0) break;
+		    if (len==0) continue;
+		    pkt.size = len;
+		    tot_pkts_received ++;
+		    last_heard = GetSimulationTime();
+		    if (first<0) first = last_heard;
+		    if (sender) Sender_FromLowerLayer(&pkt);
+		    else Receiver_FromLowerLayer(&pkt);
+		}
+	    } else if (fd==timer) {
+		/* nothing to read if the timer was restarted meanwhile */
+		uint64_t expirations;
+		if (read(timer, &expirations, sizeof(expirations))==sizeof(expirations)) {
+		    timer_set = false;
+		    if (sender) Sender_Timeout();
+		    else Receiver_Timeout();
+		}
+	    } else if (fd==arrival) {
+		uint64_t expirations;
+		if (read(arrival, &expirations, sizeof(expirations))==sizeof(expirations)) {
+		    struct message *msg = generate_msg();
+		    Sender_FromUpperLayer(msg);
+		    free_msg(msg);
+		    if (tot_chars_sent<total_bytes)
+			arm(arrival, msg_arrivalint*2.0*myrandom());
+		}
+	    }
+	}
+
+	double now = GetSimulationTime();
+	if (sender) {
+	    /* every message passed and acknowledged, the timer is left to
+	       expire once the last one is */
+	    if (tot_chars_sent==total_bytes && !timer_set) {
+		finish = last_heard;
+		break;
+	    }
+	} else {
+	    if (finish<0 && tot_chars_delivered>=total_bytes) finish = now;
+	    if (finish>=0 && now-last_heard>linger) break;
+	}
+    }
+
+    if (sender) Sender_Final();
+    else Receiver_Final();
+
+    double elapsed = finish - first;
+    long bytes = sender ? tot_chars_sent : tot_chars_delivered;
+    long pkts = tot_pkts_sent + tot_pkts_received;
+    fprintf(stdout, "\n");
+    fprintf(stdout, "## Transfer completed in %.3fs with\n"
+	    "\t%ld characters %s\n"
+	    "\t%.3f MB/s\n"
+	    "\t%ld packets sent, %ld packets received\n"
+	    "\t%.2f us CPU per packet\n",
+	    elapsed, bytes, sender ? "sent" : "delivered",
+	    (elapsed>0) ? bytes/elapsed/1e6 : 0.0,
+	    tot_pkts_sent, tot_pkts_received,
+	    (pkts>0) ? cpu_time()*1e6/pkts : 0.0);
+
+    if (!sender) {
+	if (message_verfication_passed && (tot_chars_delivered==total_bytes))
+	    fprintf(stdout, "## Congratulations! This session is error-free, loss-free, and in order.\n");
+	else
+	    fprintf(stdout, "## Something is wrong! This session is NOT error-free, loss-free, and in order.\n");
+    }
+
+    close(ep);
+    close(arrival);
+    close(timer);
+    close(sock);
+    return 0;
+}